@@ -0,0 +1,108 @@
+--Per call cost of bloomfilter against bloomfilter_fast, outside nginx:
+--  LUA_CPATH="./?.so;;" luajit bench.lua [calls]
+
+local bloomfilter = require("bloomfilter")
+local bloomfilter_fast = require("bloomfilter_fast")
+
+local os_clock = os.clock
+local str_format = string.format
+local tostring = tostring
+
+local calls = tonumber(arg and arg[1]) or 5000000
+
+local ok, err = bloomfilter_fast.init()
+if ok == nil then
+    print(err)
+    return
+end
+
+local bf = bloomfilter.new_bf(1000000, 0.01)
+for i = 1, 1000000 do
+    bloomfilter.put_uint64(bf, i * 7919)
+end
+
+local fast = bloomfilter_fast.bind(bf)
+
+local str_keys = {}
+for i = 1, 1024 do
+    str_keys[i] = tostring(i * 7919)
+end
+
+local function run(name, fn)
+    collectgarbage()
+    collectgarbage("stop")
+    local kb = collectgarbage("count")
+    local start = os_clock()
+
+    local hits = fn()
+
+    local secs = os_clock() - start
+    local garbage = collectgarbage("count") - kb
+    collectgarbage("restart")
+
+    print(str_format("%-36s %8.1f ns/call %10.1f bytes/call hits=%d",
+            name, secs * 1e9 / calls, garbage * 1024 / calls, hits))
+end
+
+run("might_contain_number", function()
+    local hits = 0
+    for i = 1, calls do
+        if bloomfilter.might_contain_number(bf, i) == 1 then
+            hits = hits + 1
+        end
+    end
+    return hits
+end)
+
+run("fast.might_contain_number", function()
+    local hits = 0
+    local contain = fast.might_contain_number
+    for i = 1, calls do
+        if contain(i) then
+            hits = hits + 1
+        end
+    end
+    return hits
+end)
+
+run("might_contain_str_number", function()
+    local hits = 0
+    for i = 1, calls do
+        if bloomfilter.might_contain_str_number(bf, str_keys[i % 1024 + 1]) == 1 then
+            hits = hits + 1
+        end
+    end
+    return hits
+end)
+
+run("fast.might_contain_str_number", function()
+    local hits = 0
+    local contain = fast.might_contain_str_number
+    for i = 1, calls do
+        if contain(str_keys[i % 1024 + 1]) then
+            hits = hits + 1
+        end
+    end
+    return hits
+end)
+
+run("might_contain_bytes", function()
+    local hits = 0
+    for i = 1, calls do
+        if bloomfilter.might_contain_bytes(bf, str_keys[i % 1024 + 1]) == 1 then
+            hits = hits + 1
+        end
+    end
+    return hits
+end)
+
+run("fast.might_contain_bytes", function()
+    local hits = 0
+    local contain = fast.might_contain_bytes
+    for i = 1, calls do
+        if contain(str_keys[i % 1024 + 1]) then
+            hits = hits + 1
+        end
+    end
+    return hits
+end)
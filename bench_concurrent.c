@@ -0,0 +1,97 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include "bloomfilter/bloomfilter.h"
+
+//puts of one run, split evenly between the threads.
+#define BENCH_KEYS      4000000
+#define BENCH_EXPECT    4000000
+#define BENCH_FPP       0.001
+#define BENCH_MAX_THREADS 64
+
+typedef struct {
+    BloomFilter *bf;
+    uint64_t begin;
+    uint64_t end;
+} BenchArg;
+
+static void *putKeys(void *p)
+{
+    BenchArg *arg = (BenchArg *)p;
+
+    for (uint64_t key = arg->begin; key < arg->end; key++) {
+        PutUint64(arg->bf, (double)key);
+    }
+
+    return NULL;
+}
+
+static double nowSec(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+//Mput/s of threads writers, and whether the keys all landed.
+static double run(int8_t magic, int threads, int concurrent, int *ok)
+{
+    pthread_t tids[BENCH_MAX_THREADS];
+    BenchArg args[BENCH_MAX_THREADS];
+    BloomFilter *bf = NewBFStrategy(BENCH_EXPECT, BENCH_FPP, magic);
+    uint64_t per = BENCH_KEYS / threads;
+    double begin = 0;
+    double cost = 0;
+
+    if (NULL == bf || !SetConcurrentBF(bf, concurrent)) {
+        *ok = 0;
+        return 0;
+    }
+
+    begin = nowSec();
+    for (int i = 0; i < threads; i++) {
+        args[i].bf = bf;
+        args[i].begin = per * i;
+        args[i].end = i == threads - 1 ? BENCH_KEYS : per * (i + 1);
+        pthread_create(&tids[i], NULL, putKeys, &args[i]);
+    }
+    for (int i = 0; i < threads; i++) {
+        pthread_join(tids[i], NULL);
+    }
+    cost = nowSec() - begin;
+
+    *ok = 1;
+    for (uint64_t key = 0; key < BENCH_KEYS; key++) {
+        if (!MightContainNumber(bf, (double)key)) {
+            *ok = 0;
+            break;
+        }
+    }
+
+    DestroyBF(bf);
+
+    return BENCH_KEYS / cost / 1000000.0;
+}
+
+int main() {
+    int8_t magics[] = {BF_MAGIC_GUAVA, BF_MAGIC_BLOCKED, BF_MAGIC_SPLIT_BLOCK};
+    const char *names[] = {"guava", "blocked", "split_block"};
+    int ok = 0;
+    double mput = 0;
+
+    for (int m = 0; m < 3; m++) {
+        mput = run(magics[m], 1, 0, &ok);
+        printf("%-12s single writer threads:1  %8.2f Mput/s %s\n", names[m], mput, ok ? "ok" : "LOST KEYS");
+
+        for (int threads = 1; threads <= BENCH_MAX_THREADS; threads *= 2) {
+            mput = run(magics[m], threads, 1, &ok);
+            printf("%-12s concurrent    threads:%-2d %8.2f Mput/s %s\n", names[m], threads, mput, ok ? "ok" : "LOST KEYS");
+        }
+    }
+
+    return 0;
+}
@@ -1,6 +1,7 @@
 local ffi = require("ffi")
 
 local ffi_gc = ffi.gc
+local ffi_new = ffi.new
 local ffi_typeof = ffi.typeof
 local new_tab = table.new
 local str_gmatch = string.gmatch
@@ -11,6 +12,8 @@ local cpath = package.cpath
 local str_format = string.format
 --local load_shared_lib = load_shared_lib
 local pcall = pcall
+local tonumber = tonumber
+local type = type
 
 ffi.cdef[[
 typedef void (*HashFunc)(const void * key, const int len, uint32_t seed, void* out);
@@ -38,7 +41,7 @@ typedef struct {
 
     //N big endian longs of the bitset behind.
 } BitSetHeader;
-#pragma unpack()
+#pragma pack()
 
 typedef struct {
     //seed
@@ -52,18 +55,191 @@ typedef struct {
 
     //bitset
     BitSetHeader *bitset;
+
+    //the longs of the bitset, layout depends on mode.
+    uint8_t *data;
+
+    //BF_MODE_*
+    uint8_t mode;
+
+    //host order copy of the header, bitset points here.
+    BitSetHeader header;
+
+    //probe loops picked by bitset->magic.
+    const struct BFStrategy *strategy;
+
+    //1->puts from many threads, see SetConcurrentBF.
+    uint8_t concurrent;
+
+    //BF_COUNTER_STRIPES set bit counters added to bit_count, or NULL.
+    //Longs 1 and 2 of a stripe count the readers, see ReplaceBitsetBF.
+    uint64_t *counters;
+
+    //bumped by each ReplaceBitsetBF of a concurrent filter.
+    uint64_t epoch;
+
+    //one bit per BF_DIRTY_WORDS longs changed since the last delta, then
+    //one per line that lost bits, or NULL.
+    uint64_t *dirty;
 } BloomFilter;
 
 BloomFilter *LoadBF(void *byte_array, double array_len);
+BloomFilter *ViewBF(const void *byte_array, size_t array_len);
+BloomFilter *LoadBFFromFile(const char *path);
+int WriteBFFile(BloomFilter *bf, const char *path);
 void DestroyBF(BloomFilter *bf);
+uint64_t BitCountBF(BloomFilter *bf);
+int SetConcurrentBF(BloomFilter *bf, int concurrent);
+int ReplaceBitsetBF(BloomFilter *bf, BloomFilter *src);
+int EnableDirtyBF(BloomFilter *bf);
+size_t DeltaSizeBF(BloomFilter *bf);
+size_t SerializeDelta(BloomFilter *bf, uint8_t *buf, size_t buf_len);
+int ApplyDelta(BloomFilter *bf, const uint8_t *buf, size_t buf_len);
 
 BloomFilter *NewBF(uint64_t expect, double fpp);
+BloomFilter *NewBFStrategy(uint64_t expect, double fpp, int8_t magic);
+BloomFilter *NewBlockedBF(uint64_t expect, double fpp);
+BloomFilter *NewSplitBlockBF(uint64_t expect, double fpp);
+BloomFilter *NewSharedBF(uint64_t expect, double fpp, int8_t magic, int fd);
+BloomFilter *AttachSharedBF(int fd);
 uint8_t * Serialized(BloomFilter *bf);
+size_t SerializedSize(BloomFilter *bf);
+size_t SerializeInto(BloomFilter *bf, uint8_t *buf, size_t buf_len);
+size_t SerializeCompact(BloomFilter *bf, uint8_t *buf, size_t buf_len);
 
 int MightContainNumber(BloomFilter *bf, double sn);
 int MightContainStrNumber(BloomFilter *bf, StrNumber sn);
+int MightContainStrNumberLen(BloomFilter *bf, const char *str, size_t len);
 
 int PutUint64(BloomFilter *bf, double sn);
+int PutBytes(BloomFilter *bf, const void *key, size_t len);
+int MightContainBytes(BloomFilter *bf, const void *key, size_t len);
+int PutInt32(BloomFilter *bf, int32_t sn);
+int MightContainInt32(BloomFilter *bf, int32_t sn);
+
+size_t MightContainNumberBatch(BloomFilter *bf, const uint64_t *keys, size_t n, uint8_t *out);
+size_t PutUint64Batch(BloomFilter *bf, const uint64_t *keys, size_t n);
+BloomFilter *BuildBF(const uint64_t *keys, size_t n, double fpp, int threads);
+BloomFilter *BuildFuseBF(const uint64_t *keys, size_t n);
+int UnionBF(BloomFilter *dst, BloomFilter *src);
+int IntersectBF(BloomFilter *dst, BloomFilter *src);
+double JaccardEstimateBF(BloomFilter *a, BloomFilter *b);
+double EstimateCountBF(BloomFilter *bf);
+double CurrentFppBF(BloomFilter *bf);
+
+typedef struct {
+    //seed
+    uint32_t seed;
+
+    //Number of hash functions.
+    uint8_t hash_num;
+
+    //longs of counters, BF_COUNTING_PER_WORD each.
+    uint32_t length;
+
+    //host order longs, 64 byte aligned.
+    uint64_t *data;
+} CountingBF;
+
+CountingBF *NewCBF(uint64_t expect, double fpp);
+int PutUint64CBF(CountingBF *cbf, double sn);
+int RemoveUint64CBF(CountingBF *cbf, double sn);
+int MightContainNumberCBF(CountingBF *cbf, double sn);
+size_t SerializedSizeCBF(CountingBF *cbf);
+size_t SerializeIntoCBF(CountingBF *cbf, uint8_t *buf, size_t buf_len);
+CountingBF *LoadCBF(const void *byte_array, size_t array_len);
+void DestroyCBF(CountingBF *cbf);
+
+typedef struct {
+    //keys expected by the first stage.
+    uint64_t expect;
+
+    //bound on the fpp of the whole chain.
+    double fpp;
+
+    //stages in use, the newest takes the puts.
+    uint8_t stages;
+
+    //set bits at which the newest stage reaches its fpp.
+    uint64_t full_bits;
+
+    //guava filters, oldest first.
+    BloomFilter *filters[32];
+} ScalableBF;
+
+ScalableBF *NewSBF(uint64_t expect, double fpp);
+int PutUint64SBF(ScalableBF *sbf, double sn);
+int MightContainNumberSBF(ScalableBF *sbf, double sn);
+size_t SerializedSizeSBF(ScalableBF *sbf);
+size_t SerializeIntoSBF(ScalableBF *sbf, uint8_t *buf, size_t buf_len);
+ScalableBF *LoadSBF(const void *byte_array, size_t array_len);
+void DestroySBF(ScalableBF *sbf);
+
+typedef struct {
+    //seed
+    uint32_t seed;
+
+    //Number of buckets, any, not only powers of two.
+    uint32_t buckets;
+
+    //keys in the filter.
+    uint64_t count;
+
+    //buckets, 64 byte aligned, padded so a bucket loads as one long.
+    uint8_t *data;
+
+    //xorshift state picking the slot to evict.
+    uint64_t rng;
+
+    //a key that found no slot: the filter is full while used.
+    uint8_t victim_used;
+    uint32_t victim_bucket;
+    uint16_t victim_fp;
+} CuckooFilter;
+
+CuckooFilter *NewCF(uint64_t expect);
+int PutUint64CF(CuckooFilter *cf, double sn);
+int RemoveUint64CF(CuckooFilter *cf, double sn);
+int MightContainNumberCF(CuckooFilter *cf, double sn);
+size_t SerializedSizeCF(CuckooFilter *cf);
+size_t SerializeIntoCF(CuckooFilter *cf, uint8_t *buf, size_t buf_len);
+CuckooFilter *LoadCF(const void *byte_array, size_t array_len);
+void DestroyCF(CuckooFilter *cf);
+
+typedef struct {
+    //seed
+    uint32_t seed;
+
+    //Number of generations, bits used of a slot.
+    uint8_t generations;
+
+    //Number of hash functions.
+    uint8_t hash_num;
+
+    //the generation taking puts.
+    uint8_t newest;
+
+    //bytes of a slot, generations / 8 rounded up.
+    uint8_t slot_bytes;
+
+    //slots, the bits of one generation.
+    uint64_t slots;
+
+    //generations a lookup reads, all but one being cleared.
+    uint64_t live;
+
+    //little endian slots, 64 byte aligned and padded by a long.
+    uint8_t *data;
+} AgingBF;
+
+AgingBF *NewABF(uint64_t expect, double fpp, int generations);
+int PutUint64ABF(AgingBF *abf, double sn);
+int MightContainNumberABF(AgingBF *abf, double sn);
+int RotateABF(AgingBF *abf);
+size_t SerializedSizeABF(AgingBF *abf);
+size_t SerializeIntoABF(AgingBF *abf, uint8_t *buf, size_t buf_len);
+AgingBF *LoadABF(const void *byte_array, size_t array_len);
+void DestroyABF(AgingBF *abf);
 
 ]]
 
@@ -87,9 +263,20 @@ local function load_shared_lib(lib_name)
     return nil, tried_paths
 end
 
-local _M = {}
+local _M = {
+    --index strategies of new_bf_strategy, see BF_MAGIC_* in bloomfilter.h.
+    MAGIC_GUAVA = 1,
+    MAGIC_FASTRANGE = 2,
+    MAGIC_POW2 = 3,
+    MAGIC_BLOCKED = 4,
+    MAGIC_SPLIT_BLOCK = 5,
+    --static, from build_fuse_bf only.
+    MAGIC_FUSE = 9,
+}
 
 local StrNumber = ffi_typeof('StrNumber')
+local uint8_arr = ffi_typeof('uint8_t[?]')
+local uint64_arr = ffi_typeof('uint64_t[?]')
 local initted = false
 local handler
 
@@ -110,6 +297,12 @@ function _M.init()
     return initted, nil
 end
 
+--the loaded libbloomfilter.so, shared with bloomfilter_fast.
+function _M.handler()
+
+    return handler
+end
+
 function _M.new_bf(expect, fpp)
     local ok, bf = pcall(handler.NewBF, expect, fpp)
     if not ok then
@@ -121,17 +314,123 @@ function _M.new_bf(expect, fpp)
     return bf, nil
 end
 
+function _M.new_bf_strategy(expect, fpp, magic)
+    local ok, bf = pcall(handler.NewBFStrategy, expect, fpp, magic)
+    if not ok then
+        return nil, str_format("aborted new bloomfilter error. %s", bf)
+    end
+
+    if bf == nil then
+        return nil, str_format("aborted new bloomfilter error. unknown magic %s.", magic)
+    end
+
+    bf = ffi_gc(bf, handler.DestroyBF)
+
+    return bf, nil
+end
+
+function _M.new_blocked_bf(expect, fpp)
+    local ok, bf = pcall(handler.NewBlockedBF, expect, fpp)
+    if not ok then
+        return nil, str_format("aborted new blocked bloomfilter error. %s", bf)
+    end
+
+    bf = ffi_gc(bf, handler.DestroyBF)
+
+    return bf, nil
+end
+
+function _M.new_split_block_bf(expect, fpp)
+    local ok, bf = pcall(handler.NewSplitBlockBF, expect, fpp)
+    if not ok then
+        return nil, str_format("aborted new split block bloomfilter error. %s", bf)
+    end
+
+    bf = ffi_gc(bf, handler.DestroyBF)
+
+    return bf, nil
+end
+
+--call from init_by_lua, before the workers fork: they all put into and
+--check the same bitset.
+function _M.new_shared_bf(expect, fpp, magic)
+    local ok, bf = pcall(handler.NewSharedBF, expect, fpp, magic or _M.MAGIC_GUAVA, -1)
+    if not ok then
+        return nil, str_format("aborted new shared bloomfilter error. %s", bf)
+    end
+
+    if bf == nil then
+        return nil, "aborted new shared bloomfilter error. mmap failed or unknown magic."
+    end
+
+    bf = ffi_gc(bf, handler.DestroyBF)
+
+    return bf, nil
+end
+
 function _M.load_bf(byte_array, array_len)
     local ok, bf = pcall(handler.LoadBF, byte_array, array_len)
     if not ok then
         return nil, str_format("aborted load bf error. %s", bf)
     end
 
+    if bf == nil then
+        return nil, "aborted load bf error. unknown magic."
+    end
+
     bf = ffi_gc(bf, handler.DestroyBF)
 
     return bf, nil
 end
 
+--zero copy, the byte_array is kept alive as long as the bf.
+function _M.view_bf(byte_array, array_len)
+    local ok, bf = pcall(handler.ViewBF, byte_array, array_len)
+    if not ok then
+        return nil, str_format("aborted view bf error. %s", bf)
+    end
+
+    if bf == nil then
+        return nil, "aborted view bf error. invalid byte array."
+    end
+
+    bf = ffi_gc(bf, function(p)
+        handler.DestroyBF(p)
+        byte_array = nil
+    end)
+
+    return bf, nil
+end
+
+--the bitset is mapped shared, all workers loading path share its pages.
+function _M.load_bf_from_file(path)
+    local ok, bf = pcall(handler.LoadBFFromFile, path)
+    if not ok then
+        return nil, str_format("aborted load bf from file error. %s", bf)
+    end
+
+    if bf == nil then
+        return nil, str_format("aborted load bf from file error. invalid file %s.", path)
+    end
+
+    bf = ffi_gc(bf, handler.DestroyBF)
+
+    return bf, nil
+end
+
+function _M.write_bf_file(bf, path)
+    local ok, res = pcall(handler.WriteBFFile, bf, path)
+    if not ok then
+        return nil, str_format("aborted write bf file error. %s", res)
+    end
+
+    if res == 0 then
+        return nil, str_format("aborted write bf file error. write %s failed.", path)
+    end
+
+    return true, nil
+end
+
 function _M.might_contain_str_number(bf, element)
     local str_number = StrNumber {str = element}
     local ok, is_in = pcall(handler.MightContainStrNumber, bf, str_number)
@@ -160,15 +459,674 @@ function _M.put_uint64(bf, element)
     return is_changed, nil
 end
 
-function _M.serialized(bf)
-    local ok, bitset = pcall(handler.Serialized, bf)
+--element is a lua string, its bytes are hashed without a copy.
+function _M.might_contain_bytes(bf, element)
+    local ok, is_in = pcall(handler.MightContainBytes, bf, element, #element)
+    if not ok then
+        return nil, str_format("aborted might_contain_bytes error. %s", is_in)
+    end
+
+    return is_in, nil
+end
+
+function _M.put_bytes(bf, element)
+    local ok, is_changed = pcall(handler.PutBytes, bf, element, #element)
+    if not ok then
+        return nil, str_format("aborted put bytes error. %s", is_changed)
+    end
+
+    return is_changed, nil
+end
+
+function _M.might_contain_int32(bf, element)
+    local ok, is_in = pcall(handler.MightContainInt32, bf, element)
+    if not ok then
+        return nil, str_format("aborted might_contain_int32 error. %s", is_in)
+    end
+
+    return is_in, nil
+end
+
+function _M.put_int32(bf, element)
+    local ok, is_changed = pcall(handler.PutInt32, bf, element)
+    if not ok then
+        return nil, str_format("aborted put int32 error. %s", is_changed)
+    end
+
+    return is_changed, nil
+end
+
+local function to_uint64_arr(elements)
+    local n = #elements
+    local keys = ffi_new(uint64_arr, n)
+    for i = 1, n do
+        keys[i - 1] = elements[i]
+    end
+
+    return keys, n
+end
+
+--one ffi call for the whole list, returns a table of 0/1, nil and the hit
+--count as a third value.
+function _M.might_contain_number_batch(bf, elements)
+    local keys, n = to_uint64_arr(elements)
+    local out = ffi_new(uint8_arr, n)
+    local ok, hits = pcall(handler.MightContainNumberBatch, bf, keys, n, out)
+    if not ok then
+        return nil, str_format("aborted might_contain_number_batch error. %s", hits)
+    end
+
+    local is_in = new_tab(n, 0)
+    for i = 1, n do
+        is_in[i] = out[i - 1]
+    end
+
+    return is_in, nil, tonumber(hits)
+end
+
+function _M.put_uint64_batch(bf, elements)
+    local keys, n = to_uint64_arr(elements)
+    local ok, changed = pcall(handler.PutUint64Batch, bf, keys, n)
+    if not ok then
+        return nil, str_format("aborted put uint64 batch error. %s", changed)
+    end
+
+    return tonumber(changed), nil
+end
+
+function _M.build_bf(elements, fpp, threads)
+    local keys, n = to_uint64_arr(elements)
+    local ok, bf = pcall(handler.BuildBF, keys, n, fpp, threads or 0)
+    if not ok then
+        return nil, str_format("aborted build bf error. %s", bf)
+    end
+
+    if bf == nil then
+        return nil, "aborted build bf error. out of memory."
+    end
+
+    bf = ffi_gc(bf, handler.DestroyBF)
+
+    return bf, nil
+end
+
+--static binary fuse filter of the list, queried with might_contain_number
+--and friends, serialized and loaded as any bf. puts are refused.
+function _M.build_fuse_bf(elements)
+    local keys, n = to_uint64_arr(elements)
+    local ok, bf = pcall(handler.BuildFuseBF, keys, n)
+    if not ok then
+        return nil, str_format("aborted build fuse bf error. %s", bf)
+    end
+
+    if bf == nil then
+        return nil, "aborted build fuse bf error. out of memory."
+    end
+
+    bf = ffi_gc(bf, handler.DestroyBF)
+
+    return bf, nil
+end
+
+function _M.bit_count(bf)
+    local ok, bit_count = pcall(handler.BitCountBF, bf)
+    if not ok then
+        return nil, str_format("aborted bit count error. %s", bit_count)
+    end
+
+    return tonumber(bit_count), nil
+end
+
+--puts are plain ORs by default, switch on before threads share the bf.
+function _M.set_concurrent(bf, concurrent)
+    local ok, set = pcall(handler.SetConcurrentBF, bf, concurrent and 1 or 0)
+    if not ok then
+        return nil, str_format("aborted set concurrent error. %s", set)
+    end
+
+    if set == 0 then
+        return nil, "aborted set concurrent error. not an owned bloomfilter or out of memory."
+    end
+
+    return true, nil
+end
+
+--a bf, or a serialized lua string read as is, e.g. straight from redis.
+local function to_bf(src)
+    if type(src) ~= "string" then
+        return src
+    end
+
+    local bf = handler.ViewBF(src, #src)
+    if bf == nil then
+        return nil
+    end
+
+    return ffi_gc(bf, handler.DestroyBF)
+end
+
+local function merge_bf(name, merge, dst, src)
+    local ok, bf = pcall(to_bf, src)
+    if not ok then
+        return nil, str_format("aborted %s error. %s", name, bf)
+    end
+
+    if bf == nil then
+        return nil, str_format("aborted %s error. invalid byte array.", name)
+    end
+
+    local merged
+    ok, merged = pcall(merge, dst, bf)
     if not ok then
-        return nil, str_format("aborted serialized error. %s", bitset)
+        return nil, str_format("aborted %s error. %s", name, merged)
+    end
+
+    if merged == 0 then
+        return nil, str_format("aborted %s error. filters differ.", name)
+    end
+
+    return true, nil
+end
+
+--dst |= src, src a bf or a serialized string.
+function _M.union_bf(dst, src)
+
+    return merge_bf("union bf", handler.UnionBF, dst, src)
+end
+
+--dst &= src, src a bf or a serialized string.
+function _M.intersect_bf(dst, src)
+
+    return merge_bf("intersect bf", handler.IntersectBF, dst, src)
+end
+
+function _M.jaccard_estimate(a, b)
+    local ok, bf_a = pcall(to_bf, a)
+    if not ok then
+        return nil, str_format("aborted jaccard estimate error. %s", bf_a)
+    end
+
+    local bf_b
+    ok, bf_b = pcall(to_bf, b)
+    if not ok then
+        return nil, str_format("aborted jaccard estimate error. %s", bf_b)
+    end
+
+    if bf_a == nil or bf_b == nil then
+        return nil, "aborted jaccard estimate error. invalid byte array."
+    end
+
+    local jaccard
+    ok, jaccard = pcall(handler.JaccardEstimateBF, bf_a, bf_b)
+    if not ok then
+        return nil, str_format("aborted jaccard estimate error. %s", jaccard)
+    end
+
+    if jaccard < 0 then
+        return nil, "aborted jaccard estimate error. filters differ."
+    end
+
+    return jaccard, nil
+end
+
+--keys put so far, nil and the fpp they leave as a third value, e.g. to
+--rebuild a filter before it saturates.
+function _M.saturation(bf)
+    local ok, count = pcall(handler.EstimateCountBF, bf)
+    if not ok then
+        return nil, str_format("aborted saturation error. %s", count)
+    end
+
+    local fpp
+    ok, fpp = pcall(handler.CurrentFppBF, bf)
+    if not ok then
+        return nil, str_format("aborted saturation error. %s", fpp)
+    end
+
+    if count < 0 or fpp < 0 then
+        return nil, "aborted saturation error. a fuse filter has no bit count."
+    end
+
+    return count, nil, fpp
+end
+
+--src, e.g. from load_bf, is consumed on success and must not be used again.
+function _M.replace_bitset(bf, src)
+    ffi_gc(src, nil)
+    local ok, replaced = pcall(handler.ReplaceBitsetBF, bf, src)
+    if not ok or replaced == 0 then
+        ffi_gc(src, handler.DestroyBF)
+        if not ok then
+            return nil, str_format("aborted replace bitset error. %s", replaced)
+        end
+        return nil, "aborted replace bitset error. filters differ."
+    end
+
+    return true, nil
+end
+
+function _M.enable_dirty(bf)
+    local ok, enabled = pcall(handler.EnableDirtyBF, bf)
+    if not ok then
+        return nil, str_format("aborted enable dirty error. %s", enabled)
+    end
+
+    if enabled == 0 then
+        return nil, "aborted enable dirty error. not an owned bloomfilter."
+    end
+
+    return true, nil
+end
+
+--the lines changed since the last call, apply_delta merges them elsewhere.
+--returns the delta, nil and its size as a third value.
+function _M.serialize_delta(bf)
+    local ok, size = pcall(handler.DeltaSizeBF, bf)
+    if not ok then
+        return nil, str_format("aborted serialize delta error. %s", size)
+    end
+
+    if size == 0 then
+        return nil, "aborted serialize delta error. call enable_dirty first."
+    end
+
+    local delta = ffi_new(uint8_arr, size)
+    ok, size = pcall(handler.SerializeDelta, bf, delta, size)
+    if not ok then
+        return nil, str_format("aborted serialize delta error. %s", size)
+    end
+
+    if size == 0 then
+        return nil, "aborted serialize delta error. buffer too small."
+    end
+
+    return delta, nil, tonumber(size)
+end
+
+--delta is a cdata buffer or a lua string, e.g. read back from redis.
+function _M.apply_delta(bf, delta, delta_len)
+    local ok, applied = pcall(handler.ApplyDelta, bf, delta, delta_len or #delta)
+    if not ok then
+        return nil, str_format("aborted apply delta error. %s", applied)
+    end
+
+    if applied == 0 then
+        return nil, "aborted apply delta error. invalid delta."
+    end
+
+    return true, nil
+end
+
+function _M.serialized_size(bf)
+    local ok, size = pcall(handler.SerializedSize, bf)
+    if not ok then
+        return nil, str_format("aborted serialized size error. %s", size)
+    end
+
+    return tonumber(size), nil
+end
+
+function _M.serialize_into(bf, buf, buf_len)
+    local ok, size = pcall(handler.SerializeInto, bf, buf, buf_len)
+    if not ok then
+        return nil, str_format("aborted serialize into error. %s", size)
+    end
+
+    if size == 0 then
+        return nil, "aborted serialize into error. buffer too small."
+    end
+
+    return tonumber(size), nil
+end
+
+--serialize into a fresh buffer, the live bf keeps working.
+function _M.serialized(bf)
+    local size, err = _M.serialized_size(bf)
+    if size == nil then
+        return nil, err
+    end
+
+    local bitset = ffi_new(uint8_arr, size)
+    size, err = _M.serialize_into(bf, bitset, size)
+    if size == nil then
+        return nil, err
     end
 
     return bitset, nil
 end
 
+--sparse when smaller, returns the buffer, nil and the bytes written as a
+--third value, load_bf takes it back with that size.
+function _M.serialized_compact(bf)
+    local size, err = _M.serialized_size(bf)
+    if size == nil then
+        return nil, err
+    end
+
+    local bitset = ffi_new(uint8_arr, size)
+    local ok, written = pcall(handler.SerializeCompact, bf, bitset, size)
+    if not ok then
+        return nil, str_format("aborted serialized compact error. %s", written)
+    end
+
+    if written == 0 then
+        return nil, "aborted serialized compact error. buffer too small."
+    end
+
+    return bitset, nil, tonumber(written)
+end
+
+--counting bloomfilter, 4 bit counters instead of bits so numbers can be
+--removed again.
+function _M.new_counting_bf(expect, fpp)
+    local ok, cbf = pcall(handler.NewCBF, expect, fpp)
+    if not ok then
+        return nil, str_format("aborted new counting bloomfilter error. %s", cbf)
+    end
+
+    if cbf == nil then
+        return nil, "aborted new counting bloomfilter error. out of memory."
+    end
+
+    cbf = ffi_gc(cbf, handler.DestroyCBF)
+
+    return cbf, nil
+end
+
+function _M.counting_put_uint64(cbf, element)
+    local ok, is_changed = pcall(handler.PutUint64CBF, cbf, element)
+    if not ok then
+        return nil, str_format("aborted counting put uint64 error. %s", is_changed)
+    end
+
+    return is_changed, nil
+end
+
+--only remove numbers put before, see RemoveUint64CBF.
+function _M.counting_remove_uint64(cbf, element)
+    local ok, is_removed = pcall(handler.RemoveUint64CBF, cbf, element)
+    if not ok then
+        return nil, str_format("aborted counting remove uint64 error. %s", is_removed)
+    end
+
+    return is_removed, nil
+end
+
+function _M.counting_might_contain_number(cbf, element)
+    local ok, is_in = pcall(handler.MightContainNumberCBF, cbf, element)
+    if not ok then
+        return nil, str_format("aborted counting might_contain_number error. %s", is_in)
+    end
+
+    return is_in, nil
+end
+
+--returns the buffer, nil and its size as a third value.
+function _M.counting_serialized(cbf)
+    local ok, size = pcall(handler.SerializedSizeCBF, cbf)
+    if not ok then
+        return nil, str_format("aborted counting serialized error. %s", size)
+    end
+
+    local buf = ffi_new(uint8_arr, size)
+    ok, size = pcall(handler.SerializeIntoCBF, cbf, buf, size)
+    if not ok then
+        return nil, str_format("aborted counting serialized error. %s", size)
+    end
+
+    if size == 0 then
+        return nil, "aborted counting serialized error. buffer too small."
+    end
+
+    return buf, nil, tonumber(size)
+end
+
+function _M.load_counting_bf(byte_array, array_len)
+    local ok, cbf = pcall(handler.LoadCBF, byte_array, array_len or #byte_array)
+    if not ok then
+        return nil, str_format("aborted load counting bf error. %s", cbf)
+    end
+
+    if cbf == nil then
+        return nil, "aborted load counting bf error. invalid byte array."
+    end
+
+    cbf = ffi_gc(cbf, handler.DestroyCBF)
+
+    return cbf, nil
+end
+
+--scalable bloomfilter, grows past expect instead of losing its fpp.
+function _M.new_scalable_bf(expect, fpp)
+    local ok, sbf = pcall(handler.NewSBF, expect, fpp)
+    if not ok then
+        return nil, str_format("aborted new scalable bloomfilter error. %s", sbf)
+    end
+
+    if sbf == nil then
+        return nil, "aborted new scalable bloomfilter error. out of memory or fpp not above 0."
+    end
+
+    sbf = ffi_gc(sbf, handler.DestroySBF)
+
+    return sbf, nil
+end
+
+function _M.scalable_put_uint64(sbf, element)
+    local ok, is_changed = pcall(handler.PutUint64SBF, sbf, element)
+    if not ok then
+        return nil, str_format("aborted scalable put uint64 error. %s", is_changed)
+    end
+
+    return is_changed, nil
+end
+
+function _M.scalable_might_contain_number(sbf, element)
+    local ok, is_in = pcall(handler.MightContainNumberSBF, sbf, element)
+    if not ok then
+        return nil, str_format("aborted scalable might_contain_number error. %s", is_in)
+    end
+
+    return is_in, nil
+end
+
+--returns the buffer, nil and its size as a third value.
+function _M.scalable_serialized(sbf)
+    local ok, size = pcall(handler.SerializedSizeSBF, sbf)
+    if not ok then
+        return nil, str_format("aborted scalable serialized error. %s", size)
+    end
+
+    local buf = ffi_new(uint8_arr, size)
+    ok, size = pcall(handler.SerializeIntoSBF, sbf, buf, size)
+    if not ok then
+        return nil, str_format("aborted scalable serialized error. %s", size)
+    end
+
+    if size == 0 then
+        return nil, "aborted scalable serialized error. buffer too small."
+    end
+
+    return buf, nil, tonumber(size)
+end
+
+function _M.load_scalable_bf(byte_array, array_len)
+    local ok, sbf = pcall(handler.LoadSBF, byte_array, array_len or #byte_array)
+    if not ok then
+        return nil, str_format("aborted load scalable bf error. %s", sbf)
+    end
+
+    if sbf == nil then
+        return nil, "aborted load scalable bf error. invalid byte array."
+    end
+
+    sbf = ffi_gc(sbf, handler.DestroySBF)
+
+    return sbf, nil
+end
+
+--cuckoo filter, no bigger than a bloomfilter at fpp 0.001 and supports remove.
+function _M.new_cuckoo_filter(expect)
+    local ok, cf = pcall(handler.NewCF, expect)
+    if not ok then
+        return nil, str_format("aborted new cuckoo filter error. %s", cf)
+    end
+
+    if cf == nil then
+        return nil, "aborted new cuckoo filter error. out of memory."
+    end
+
+    cf = ffi_gc(cf, handler.DestroyCF)
+
+    return cf, nil
+end
+
+function _M.cuckoo_put_uint64(cf, element)
+    local ok, is_put = pcall(handler.PutUint64CF, cf, element)
+    if not ok then
+        return nil, str_format("aborted cuckoo put uint64 error. %s", is_put)
+    end
+
+    if is_put == 0 then
+        return nil, "aborted cuckoo put uint64 error. filter is full."
+    end
+
+    return is_put, nil
+end
+
+--only remove numbers put before, see RemoveUint64CF.
+function _M.cuckoo_remove_uint64(cf, element)
+    local ok, is_removed = pcall(handler.RemoveUint64CF, cf, element)
+    if not ok then
+        return nil, str_format("aborted cuckoo remove uint64 error. %s", is_removed)
+    end
+
+    return is_removed, nil
+end
+
+function _M.cuckoo_might_contain_number(cf, element)
+    local ok, is_in = pcall(handler.MightContainNumberCF, cf, element)
+    if not ok then
+        return nil, str_format("aborted cuckoo might_contain_number error. %s", is_in)
+    end
+
+    return is_in, nil
+end
+
+--returns the buffer, nil and its size as a third value.
+function _M.cuckoo_serialized(cf)
+    local ok, size = pcall(handler.SerializedSizeCF, cf)
+    if not ok then
+        return nil, str_format("aborted cuckoo serialized error. %s", size)
+    end
+
+    local buf = ffi_new(uint8_arr, size)
+    ok, size = pcall(handler.SerializeIntoCF, cf, buf, size)
+    if not ok then
+        return nil, str_format("aborted cuckoo serialized error. %s", size)
+    end
+
+    if size == 0 then
+        return nil, "aborted cuckoo serialized error. buffer too small."
+    end
+
+    return buf, nil, tonumber(size)
+end
+
+function _M.load_cuckoo_filter(byte_array, array_len)
+    local ok, cf = pcall(handler.LoadCF, byte_array, array_len or #byte_array)
+    if not ok then
+        return nil, str_format("aborted load cuckoo filter error. %s", cf)
+    end
+
+    if cf == nil then
+        return nil, "aborted load cuckoo filter error. invalid byte array."
+    end
+
+    cf = ffi_gc(cf, handler.DestroyCF)
+
+    return cf, nil
+end
+
+--generations bloomfilters in one, e.g. 24 of an hour: one call checks them
+--all, rotate_aging_bf from a timer drops the oldest.
+function _M.new_aging_bf(expect, fpp, generations)
+    local ok, abf = pcall(handler.NewABF, expect, fpp, generations)
+    if not ok then
+        return nil, str_format("aborted new aging bloomfilter error. %s", abf)
+    end
+
+    if abf == nil then
+        return nil, str_format("aborted new aging bloomfilter error. bad generations %s.", generations)
+    end
+
+    abf = ffi_gc(abf, handler.DestroyABF)
+
+    return abf, nil
+end
+
+function _M.aging_put_uint64(abf, element)
+    local ok, is_changed = pcall(handler.PutUint64ABF, abf, element)
+    if not ok then
+        return nil, str_format("aborted aging put uint64 error. %s", is_changed)
+    end
+
+    return is_changed, nil
+end
+
+function _M.aging_might_contain_number(abf, element)
+    local ok, is_in = pcall(handler.MightContainNumberABF, abf, element)
+    if not ok then
+        return nil, str_format("aborted aging might_contain_number error. %s", is_in)
+    end
+
+    return is_in, nil
+end
+
+function _M.rotate_aging_bf(abf)
+    local ok, newest = pcall(handler.RotateABF, abf)
+    if not ok then
+        return nil, str_format("aborted rotate aging bf error. %s", newest)
+    end
+
+    return newest, nil
+end
+
+--returns the buffer, nil and its size as a third value.
+function _M.aging_serialized(abf)
+    local ok, size = pcall(handler.SerializedSizeABF, abf)
+    if not ok then
+        return nil, str_format("aborted aging serialized error. %s", size)
+    end
+
+    local buf = ffi_new(uint8_arr, size)
+    ok, size = pcall(handler.SerializeIntoABF, abf, buf, size)
+    if not ok then
+        return nil, str_format("aborted aging serialized error. %s", size)
+    end
+
+    if size == 0 then
+        return nil, "aborted aging serialized error. buffer too small."
+    end
+
+    return buf, nil, tonumber(size)
+end
+
+function _M.load_aging_bf(byte_array, array_len)
+    local ok, abf = pcall(handler.LoadABF, byte_array, array_len or #byte_array)
+    if not ok then
+        return nil, str_format("aborted load aging bf error. %s", abf)
+    end
+
+    if abf == nil then
+        return nil, "aborted load aging bf error. invalid byte array."
+    end
+
+    abf = ffi_gc(abf, handler.DestroyABF)
+
+    return abf, nil
+end
+
 function _M.print_barr(byte_array, array_len)
     local buf = ""
     buf = buf .. "["
@@ -0,0 +1,306 @@
+/*
+BSD 3-Clause License
+
+Copyright (c) 2020, _Xiangqian
+        All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+        this list of conditions and the following disclaimer in the documentation
+and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+contributors may be used to endorse or promote products derived from
+        this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+        IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+        FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+        CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define _DEFAULT_SOURCE
+
+#include <endian.h>
+#include "agingbf.h"
+
+#define BF_ALWAYS_INLINE    static inline __attribute__((always_inline))
+
+#define BF_AGING_ALIGN      64
+
+BF_ALWAYS_INLINE uint64_t generationMask(int generations)
+{
+    return generations == 64 ? UINT64_MAX : ((uint64_t)1 << generations) - 1;
+}
+
+//generations / 8 rounded up, 24 generations take 3 bytes a slot.
+static uint8_t slotBytes(int generations)
+{
+    return (uint8_t)((generations + 7) / 8);
+}
+
+//the bytes of slot i and the ones after it, a lookup masks them off with
+//live. Plain loads, each generation bit is one byte's and a put or a
+//rotate changes it whole.
+BF_ALWAYS_INLINE uint64_t slotLoad(const AgingBF *abf, uint64_t i)
+{
+    uint64_t slot = 0;
+
+    memcpy(&slot, abf->data + i * abf->slot_bytes, sizeof(uint64_t));
+
+    return le64toh(slot);
+}
+
+//longs of data, the slots padded so the last one loads as a long.
+BF_ALWAYS_INLINE uint64_t dataWords(const AgingBF *abf)
+{
+    return (abf->slots * abf->slot_bytes + sizeof(uint64_t) - 1) / sizeof(uint64_t) + 1;
+}
+
+static AgingBF *allocABF(int generations, int hash_num, uint64_t slots)
+{
+    AgingBF *abf    = NULL;
+    void *data      = NULL;
+    size_t size     = 0;
+
+    abf = (AgingBF *)calloc(1, sizeof(AgingBF));
+    if (NULL == abf) {
+        return NULL;
+    }
+
+    abf->seed = 0;
+    abf->generations = (uint8_t)generations;
+    abf->hash_num = (uint8_t)hash_num;
+    abf->slot_bytes = slotBytes(generations);
+    abf->slots = slots;
+    abf->live = generationMask(generations);
+
+    size = dataWords(abf) * sizeof(uint64_t);
+    size = (size + BF_AGING_ALIGN - 1) / BF_AGING_ALIGN * BF_AGING_ALIGN;
+    if (posix_memalign(&data, BF_AGING_ALIGN, size) != 0) {
+        free(abf);
+        return NULL;
+    }
+
+    memset(data, 0, size);
+    abf->data = (uint8_t *)data;
+
+    return abf;
+}
+
+AgingBF *NewABF(uint64_t expect, double fpp, int generations)
+{
+    uint64_t slots  = 0;
+    int hash_num    = 0;
+
+    if (generations < 1 || generations > BF_AGING_MAX_GENERATIONS) {
+        return NULL;
+    }
+
+    if (expect == 0) {
+        expect = 1;
+    }
+
+    //a lookup is a false positive of any of the generations.
+    slots = OptimalNumOfBits(expect, fpp / generations);
+    if (slots < 64) {
+        slots = 64;
+    }
+    hash_num = OptimalNumOfHash(expect, slots);
+    if (hash_num > UINT8_MAX || slots > (uint64_t)(SIZE_MAX / 2 / sizeof(uint64_t))) {
+        return NULL;
+    }
+
+    return allocABF(generations, hash_num, slots);
+}
+
+int PutUint64ABF(AgingBF *abf, double sn)
+{
+    uint64_t out[2]     = {0};
+    uint64_t combine    = 0;
+    uint8_t *data       = NULL;
+    uint8_t bit         = 0;
+    int newest          = 0;
+    int changed         = 0;
+
+    if (NULL == abf) {
+        return 0;
+    }
+
+    MurmurHash3_x64_128_u64((uint64_t)sn, abf->seed, out);
+    combine = *out;
+    newest = __atomic_load_n(&abf->newest, __ATOMIC_ACQUIRE);
+    //generation newest is one bit of one byte of every slot.
+    data = abf->data + newest / 8;
+    bit = (uint8_t)(1 << (newest % 8));
+
+    //atomic, other puts and a rotate may change the same byte.
+    for (int i = 0; i < abf->hash_num; i++) {
+        uint8_t *byte = data + (combine & INT64_MAX) % abf->slots * abf->slot_bytes;
+
+        if (!(__atomic_load_n(byte, __ATOMIC_RELAXED) & bit)) {
+            changed |= !(__atomic_fetch_or(byte, bit, __ATOMIC_RELAXED) & bit);
+        }
+        combine += *(out + 1);
+    }
+
+    return changed;
+}
+
+int MightContainNumberABF(AgingBF *abf, double sn)
+{
+    uint64_t out[2]     = {0};
+    uint64_t combine    = 0;
+    uint64_t holding    = 0;
+
+    if (NULL == abf) {
+        return 0;
+    }
+
+    MurmurHash3_x64_128_u64((uint64_t)sn, abf->seed, out);
+    combine = *out;
+    holding = __atomic_load_n(&abf->live, __ATOMIC_ACQUIRE);
+
+    for (int i = 0; i < abf->hash_num && holding; i++) {
+        holding &= slotLoad(abf, (combine & INT64_MAX) % abf->slots);
+        combine += *(out + 1);
+    }
+
+    return holding != 0;
+}
+
+int RotateABF(AgingBF *abf)
+{
+    uint8_t pattern[BF_AGING_MAX_GENERATIONS];
+    uint64_t keep[BF_AGING_MAX_GENERATIONS / 8];
+    uint64_t *words     = NULL;
+    uint64_t bit        = 0;
+    int oldest          = 0;
+
+    if (NULL == abf) {
+        return -1;
+    }
+
+    oldest = (abf->newest + 1) % abf->generations;
+    bit = (uint64_t)1 << oldest;
+
+    //out of lookups before its bits go, so none sees it half cleared.
+    __atomic_store_n(&abf->live, abf->live & ~bit, __ATOMIC_RELEASE);
+
+    //slot_bytes longs hold 8 whole slots, so the pattern repeats every
+    //slot_bytes longs.
+    memset(pattern, 0xff, sizeof(pattern));
+    for (int i = 0; i < 8; i++) {
+        *(pattern + i * abf->slot_bytes + oldest / 8) = (uint8_t)~(1 << (oldest % 8));
+    }
+    memcpy(keep, pattern, sizeof(keep));
+
+    //every long, the whole filter, the only way to reach one bit a slot.
+    words = (uint64_t *)abf->data;
+    for (uint64_t i = 0; i < dataWords(abf); i++) {
+        uint64_t mask = *(keep + i % abf->slot_bytes);
+
+        if (__atomic_load_n(words + i, __ATOMIC_RELAXED) & ~mask) {
+            __atomic_fetch_and(words + i, mask, __ATOMIC_RELAXED);
+        }
+    }
+
+    __atomic_store_n(&abf->newest, (uint8_t)oldest, __ATOMIC_RELEASE);
+    __atomic_store_n(&abf->live, abf->live | bit, __ATOMIC_RELEASE);
+
+    return oldest;
+}
+
+size_t SerializedSizeABF(AgingBF *abf)
+{
+    if (NULL == abf) {
+        return 0;
+    }
+
+    return BF_AGING_HEADER_LEN + (size_t)(abf->slots * abf->slot_bytes);
+}
+
+size_t SerializeIntoABF(AgingBF *abf, uint8_t *buf, size_t buf_len)
+{
+    size_t size         = SerializedSizeABF(abf);
+    uint64_t slots      = 0;
+
+    if (size == 0 || NULL == buf || buf_len < size) {
+        return 0;
+    }
+
+    slots = BF_HTONLL(abf->slots);
+
+    *buf = BF_MAGIC_AGING;
+    *(buf + 1) = abf->generations;
+    *(buf + 2) = abf->hash_num;
+    *(buf + 3) = abf->newest;
+    memcpy(buf + 4, &slots, sizeof(uint64_t));
+
+    //the slots are little endian bytes in memory already.
+    memcpy(buf + BF_AGING_HEADER_LEN, abf->data, size - BF_AGING_HEADER_LEN);
+
+    return size;
+}
+
+AgingBF *LoadABF(const void *byte_array, size_t array_len)
+{
+    const uint8_t *buf  = (const uint8_t *)byte_array;
+    AgingBF *abf        = NULL;
+    uint64_t slots      = 0;
+    int generations     = 0;
+
+    if (NULL == buf || array_len < BF_AGING_HEADER_LEN || (int8_t)*buf != BF_MAGIC_AGING) {
+        return NULL;
+    }
+
+    generations = *(buf + 1);
+    memcpy(&slots, buf + 4, sizeof(uint64_t));
+    slots = BF_NTOHLL(slots);
+
+    if (generations < 1 || generations > BF_AGING_MAX_GENERATIONS || *(buf + 2) == 0
+            || *(buf + 3) >= generations || slots == 0
+            || slots > (array_len - BF_AGING_HEADER_LEN) / slotBytes(generations)
+            || array_len != BF_AGING_HEADER_LEN + slots * slotBytes(generations)) {
+        return NULL;
+    }
+
+    abf = allocABF(generations, *(buf + 2), slots);
+    if (NULL == abf) {
+        return NULL;
+    }
+
+    abf->newest = *(buf + 3);
+
+    memcpy(abf->data, buf + BF_AGING_HEADER_LEN, array_len - BF_AGING_HEADER_LEN);
+
+    //bits past the generations in the last byte of a slot stay 0.
+    if (generations % 8 != 0) {
+        for (uint64_t i = 0; i < slots; i++) {
+            *(abf->data + i * abf->slot_bytes + abf->slot_bytes - 1) &= (uint8_t)((1 << (generations % 8)) - 1);
+        }
+    }
+
+    return abf;
+}
+
+void DestroyABF(AgingBF *abf)
+{
+    if (NULL == abf) {
+        return;
+    }
+
+    free(abf->data);
+    free(abf);
+}
@@ -0,0 +1,213 @@
+/*
+BSD 3-Clause License
+
+Copyright (c) 2020, _Xiangqian
+        All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+        this list of conditions and the following disclaimer in the documentation
+and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+contributors may be used to endorse or promote products derived from
+        this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+        IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+        FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+        CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef BLOOMFILTER_AGINGBF_H
+#define BLOOMFILTER_AGINGBF_H
+
+#include "bloomfilter.h"
+
+#define BF_AGING_MAX_GENERATIONS    64
+
+//[int8 BF_MAGIC_AGING][uint8 generations][uint8 hash_num][uint8 newest]
+//[uint64 BE slots] then the slots, generations / 8 rounded up bytes each.
+#define BF_AGING_HEADER_LEN     12
+
+/*
+ * The generations are interleaved: slot i holds bit i of every generation,
+ * generation g at bit g % 8 of byte g / 8. A lookup ANDs its hash_num
+ * slots, what is left is the generations holding the key, so all of them
+ * cost one probe walk. The price is a rotate: one bit of every slot is
+ * cleared, so it walks the whole filter.
+ */
+
+typedef struct {
+    //seed
+    uint32_t seed;
+
+    //Number of generations, bits used of a slot.
+    uint8_t generations;
+
+    //Number of hash functions.
+    uint8_t hash_num;
+
+    //the generation taking puts.
+    uint8_t newest;
+
+    //bytes of a slot, generations / 8 rounded up.
+    uint8_t slot_bytes;
+
+    //slots, the bits of one generation.
+    uint64_t slots;
+
+    //generations a lookup reads, all but one being cleared.
+    uint64_t live;
+
+    //little endian slots, 64 byte aligned and padded by a long.
+    uint8_t *data;
+} AgingBF;
+
+/*
+ * @Description : New an age partitioned bloom filter, generations filters
+ *                of expect keys in one allocation, e.g. 24 of an hour. A
+ *                key is hashed once, for all of them. Each generation is
+ *                sized for fpp / generations, so lookups across all stay
+ *                within fpp. Puts and lookups from any threads, and one
+ *                RotateABF at a time along them.
+ * @Date        : 2026-10-17
+ * @Author      : Xiangqian5
+ * @Software    : Weibo Inc.
+ *
+ * @param:
+ *  expect      : The number of elements of one generation.
+ *  fpp         : The rate of false positive of a lookup.
+ *  generations : 1 to BF_AGING_MAX_GENERATIONS.
+ *
+ * @return:
+ *  abf         : The aging bloom filter. NULL->bad generations or out of
+ *                memory.
+ */
+
+AgingBF *NewABF(uint64_t expect, double fpp, int generations);
+
+/*
+ * @Description : Put a number into the newest generation.
+ * @Date        : 2026-10-17
+ * @Author      : Xiangqian5
+ * @Software    : Weibo Inc.
+ *
+ * @param:
+ *  abf         : The aging bloom filter.
+ *  sn          : The number, hashed as PutUint64 does.
+ *
+ * @return:
+ *  changed     : 1->a bit of the newest generation changed.
+ */
+
+int PutUint64ABF(AgingBF *abf, double sn);
+
+/*
+ * @Description : Check a number is in any live generation or not.
+ * @Date        : 2026-10-17
+ * @Author      : Xiangqian5
+ * @Software    : Weibo Inc.
+ *
+ * @param:
+ *  abf         : The aging bloom filter.
+ *  sn          : The number.
+ *
+ * @return:
+ *  is_in       : 0->not in. 1->in.
+ */
+
+int MightContainNumberABF(AgingBF *abf, double sn);
+
+/*
+ * @Description : Drop the oldest generation and make it the newest, empty.
+ *                O(size): it reads every long of the filter to clear one
+ *                bit a slot, about 1 ms a MB. Lookups and puts carry on
+ *                meanwhile, lookups without the generation being cleared,
+ *                so it may run from a background thread. One at a time.
+ * @Date        : 2026-10-17
+ * @Author      : Xiangqian5
+ * @Software    : Weibo Inc.
+ *
+ * @param:
+ *  abf         : The aging bloom filter.
+ *
+ * @return:
+ *  newest      : The new newest generation. -1->abf is NULL.
+ */
+
+int RotateABF(AgingBF *abf);
+
+/*
+ * @Description : Bytes SerializeIntoABF writes, BF_AGING_HEADER_LEN then
+ *                the slots.
+ * @Date        : 2026-10-17
+ * @Author      : Xiangqian5
+ * @Software    : Weibo Inc.
+ *
+ * @param:
+ *  abf         : The aging bloom filter.
+ *
+ * @return:
+ *  size        : Bytes. 0->abf is NULL.
+ */
+
+size_t SerializedSizeABF(AgingBF *abf);
+
+/*
+ * @Description : Serialize all generations into buf.
+ * @Date        : 2026-10-17
+ * @Author      : Xiangqian5
+ * @Software    : Weibo Inc.
+ *
+ * @param:
+ *  abf         : The aging bloom filter.
+ *  buf         : Output buffer.
+ *  buf_len     : Length of buf, at least SerializedSizeABF(abf).
+ *
+ * @return:
+ *  size        : Bytes written. 0->fail.
+ */
+
+size_t SerializeIntoABF(AgingBF *abf, uint8_t *buf, size_t buf_len);
+
+/*
+ * @Description : Load an aging bloom filter from SerializeIntoABF bytes.
+ * @Date        : 2026-10-17
+ * @Author      : Xiangqian5
+ * @Software    : Weibo Inc.
+ *
+ * @param:
+ *  byte_array  : byte array.
+ *  array_len   : length of byte array.
+ *
+ * @return:
+ *  abf         : The aging bloom filter. NULL->invalid byte array.
+ */
+
+AgingBF *LoadABF(const void *byte_array, size_t array_len);
+
+/*
+ * @Description : Free an aging bloom filter.
+ * @Date        : 2026-10-17
+ * @Author      : Xiangqian5
+ * @Software    : Weibo Inc.
+ *
+ * @param:
+ *  abf         : The aging bloom filter.
+ */
+
+void DestroyABF(AgingBF *abf);
+
+#endif //BLOOMFILTER_AGINGBF_H
@@ -30,395 +30,3499 @@ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#define _DEFAULT_SOURCE
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "bloomfilter.h"
 
-uint64_t bitCount(uint64_t i)
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define BF_HAVE_AVX2        1
+#endif
+
+#define BF_ALWAYS_INLINE    static inline __attribute__((always_inline))
+
+#define BF_CHECKSUM_PRIME   0x9e3779b97f4a7c15ULL
+#define BF_FILE_CHUNK       1024
+
+//owned longs start on a cache line, with the header right before them.
+#define BF_DATA_ALIGN       64
+
+//multiplier deriving the next probe of a block, odd.
+#define BF_BLOCK_REHASH     0x9e3779b97f4a7c13ULL
+//largest hash_num tried when sizing a blocked filter.
+#define BF_BLOCK_MAX_HASH   24
+//largest bit_size a blocked or split block filter grows to, length is an int.
+#define BF_MAX_GROW_BITS    ((uint64_t)INT32_MAX * 64)
+//largest hash_num with its own unrolled kernel.
+#define BF_KERNEL_MAX_HASH  16
+
+//keys hashed and prefetched together by the batch api.
+#define BF_BATCH            16
+//probes per key remembered between the prefetch and resolve passes.
+#define BF_BATCH_PROBES     16
+
+//keys one BuildBF thread hashes per round, and the thread cap.
+#define BF_BUILD_CHUNK      65536
+#define BF_BUILD_MAX_THREADS 256
+
+//zeroed header and longs, data at (uint8_t *)bitset + HEADER_LEN is aligned,
+//so word CAS never splits a cache line.
+BitSetHeader *allocBitset(uint32_t length)
+{
+    size_t size = BF_DATA_ALIGN + sizeof(uint64_t) * (size_t)length;
+    void *base  = NULL;
+
+    if (posix_memalign(&base, BF_DATA_ALIGN, size) != 0) {
+        return NULL;
+    }
+
+    memset(base, 0, size);
+
+    return (BitSetHeader *)((uint8_t *)base + BF_DATA_ALIGN - HEADER_LEN);
+}
+
+void freeBitset(BitSetHeader *bitset)
+{
+    free((uint8_t *)bitset - (BF_DATA_ALIGN - HEADER_LEN));
+}
+
+/*
+ * Byte order kernels: copy n longs from src to dst between host and wire
+ * order, returning their set bits. Either side may be unaligned, and dst
+ * may be src. A byte swap keeps the bit count, so one pass does both.
+ */
+
+typedef uint64_t (*SwapCountFunc)(void *dst, const void *src, size_t n);
+
+BF_ALWAYS_INLINE uint64_t swapCountWords(void *dst, const void *src, size_t n)
+{
+    uint64_t count = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        uint64_t word = 0;
+
+        memcpy(&word, (const uint8_t *)src + i * sizeof(uint64_t), sizeof(uint64_t));
+        word = BF_NTOHLL(word);
+        count += __builtin_popcountll(word);
+        memcpy((uint8_t *)dst + i * sizeof(uint64_t), &word, sizeof(uint64_t));
+    }
+
+    return count;
+}
+
+static uint64_t swapCountScalar(void *dst, const void *src, size_t n)
+{
+    return swapCountWords(dst, src, n);
+}
+
+#ifdef BF_HAVE_AVX2
+
+__attribute__((target("popcnt")))
+static uint64_t swapCountPopcnt(void *dst, const void *src, size_t n)
+{
+    return swapCountWords(dst, src, n);
+}
+
+//pshufb swaps the bytes of each long, and counts bits by nibble lookup.
+__attribute__((target("avx2,popcnt")))
+static uint64_t swapCountAvx2(void *dst, const void *src, size_t n)
+{
+    const __m256i swap  = _mm256_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8,
+                                           7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+    const __m256i bits  = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                           0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i low   = _mm256_set1_epi8(0x0f);
+    const uint8_t *in   = (const uint8_t *)src;
+    uint8_t *out        = (uint8_t *)dst;
+    __m256i sum         = _mm256_setzero_si256();
+    uint64_t count      = 0;
+    size_t i            = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(in + i * sizeof(uint64_t)));
+        __m256i c = _mm256_add_epi8(_mm256_shuffle_epi8(bits, _mm256_and_si256(v, low)),
+                                    _mm256_shuffle_epi8(bits, _mm256_and_si256(_mm256_srli_epi16(v, 4), low)));
+
+        sum = _mm256_add_epi64(sum, _mm256_sad_epu8(c, _mm256_setzero_si256()));
+        _mm256_storeu_si256((__m256i *)(out + i * sizeof(uint64_t)), _mm256_shuffle_epi8(v, swap));
+    }
+
+    count = (uint64_t)_mm256_extract_epi64(sum, 0) + (uint64_t)_mm256_extract_epi64(sum, 1)
+            + (uint64_t)_mm256_extract_epi64(sum, 2) + (uint64_t)_mm256_extract_epi64(sum, 3);
+
+    return count + swapCountWords(out + i * sizeof(uint64_t), in + i * sizeof(uint64_t), n - i);
+}
+
+#endif
+
+static SwapCountFunc findSwapCount(void)
+{
+#ifdef BF_HAVE_AVX2
+    if (__builtin_cpu_supports("avx2")) {
+        return swapCountAvx2;
+    }
+
+    if (__builtin_cpu_supports("popcnt")) {
+        return swapCountPopcnt;
+    }
+#endif
+
+    return swapCountScalar;
+}
+
+/*
+ * Set algebra kernels: dst |= src or dst &= src over n host order longs,
+ * returning the bits that flipped, so bit_count follows without a recount.
+ */
+
+typedef uint64_t (*MergeFunc)(uint64_t *dst, const uint64_t *src, size_t n);
+
+BF_ALWAYS_INLINE uint64_t mergeWords(uint64_t *dst, const uint64_t *src, size_t n, int intersect)
+{
+    uint64_t count = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        uint64_t word = intersect ? *(dst + i) & *(src + i) : *(dst + i) | *(src + i);
+
+        count += __builtin_popcountll(word ^ *(dst + i));
+        *(dst + i) = word;
+    }
+
+    return count;
+}
+
+static uint64_t unionScalar(uint64_t *dst, const uint64_t *src, size_t n)
+{
+    return mergeWords(dst, src, n, 0);
+}
+
+static uint64_t intersectScalar(uint64_t *dst, const uint64_t *src, size_t n)
+{
+    return mergeWords(dst, src, n, 1);
+}
+
+#ifdef BF_HAVE_AVX2
+
+//per long bit counts of v, by nibble lookup.
+__attribute__((target("avx2")))
+static inline __m256i popcountAvx2(__m256i v)
+{
+    const __m256i bits  = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                           0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i low   = _mm256_set1_epi8(0x0f);
+    __m256i c           = _mm256_add_epi8(_mm256_shuffle_epi8(bits, _mm256_and_si256(v, low)),
+                                          _mm256_shuffle_epi8(bits, _mm256_and_si256(_mm256_srli_epi16(v, 4), low)));
+
+    return _mm256_sad_epu8(c, _mm256_setzero_si256());
+}
+
+__attribute__((target("avx2")))
+static inline uint64_t sumAvx2(__m256i sum)
+{
+    return (uint64_t)_mm256_extract_epi64(sum, 0) + (uint64_t)_mm256_extract_epi64(sum, 1)
+           + (uint64_t)_mm256_extract_epi64(sum, 2) + (uint64_t)_mm256_extract_epi64(sum, 3);
+}
+
+__attribute__((target("avx2,popcnt")))
+static inline uint64_t mergeAvx2(uint64_t *dst, const uint64_t *src, size_t n, int intersect)
+{
+    __m256i sum = _mm256_setzero_si256();
+    size_t i    = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        __m256i d = _mm256_loadu_si256((const __m256i *)(dst + i));
+        __m256i v = _mm256_loadu_si256((const __m256i *)(src + i));
+        __m256i w = intersect ? _mm256_and_si256(d, v) : _mm256_or_si256(d, v);
+
+        sum = _mm256_add_epi64(sum, popcountAvx2(_mm256_xor_si256(w, d)));
+        _mm256_storeu_si256((__m256i *)(dst + i), w);
+    }
+
+    return sumAvx2(sum) + mergeWords(dst + i, src + i, n - i, intersect);
+}
+
+__attribute__((target("avx2,popcnt")))
+static uint64_t unionAvx2(uint64_t *dst, const uint64_t *src, size_t n)
+{
+    return mergeAvx2(dst, src, n, 0);
+}
+
+__attribute__((target("avx2,popcnt")))
+static uint64_t intersectAvx2(uint64_t *dst, const uint64_t *src, size_t n)
+{
+    return mergeAvx2(dst, src, n, 1);
+}
+
+#endif
+
+static MergeFunc findMerge(int intersect)
+{
+#ifdef BF_HAVE_AVX2
+    if (__builtin_cpu_supports("avx2")) {
+        return intersect ? intersectAvx2 : unionAvx2;
+    }
+#endif
+
+    return intersect ? intersectScalar : unionScalar;
+}
+
+//bits set in a, in b and in a | b.
+typedef void (*UnionCountFunc)(const uint64_t *a, const uint64_t *b, size_t n, uint64_t *counts);
+
+BF_ALWAYS_INLINE void unionCountWords(const uint64_t *a, const uint64_t *b, size_t n, uint64_t *counts)
+{
+    for (size_t i = 0; i < n; i++) {
+        *counts += __builtin_popcountll(*(a + i));
+        *(counts + 1) += __builtin_popcountll(*(b + i));
+        *(counts + 2) += __builtin_popcountll(*(a + i) | *(b + i));
+    }
+}
+
+static void unionCountScalar(const uint64_t *a, const uint64_t *b, size_t n, uint64_t *counts)
+{
+    unionCountWords(a, b, n, counts);
+}
+
+#ifdef BF_HAVE_AVX2
+
+__attribute__((target("avx2,popcnt")))
+static void unionCountAvx2(const uint64_t *a, const uint64_t *b, size_t n, uint64_t *counts)
+{
+    __m256i sum_a   = _mm256_setzero_si256();
+    __m256i sum_b   = _mm256_setzero_si256();
+    __m256i sum_u   = _mm256_setzero_si256();
+    size_t i        = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        __m256i x = _mm256_loadu_si256((const __m256i *)(a + i));
+        __m256i y = _mm256_loadu_si256((const __m256i *)(b + i));
+
+        sum_a = _mm256_add_epi64(sum_a, popcountAvx2(x));
+        sum_b = _mm256_add_epi64(sum_b, popcountAvx2(y));
+        sum_u = _mm256_add_epi64(sum_u, popcountAvx2(_mm256_or_si256(x, y)));
+    }
+
+    *counts += sumAvx2(sum_a);
+    *(counts + 1) += sumAvx2(sum_b);
+    *(counts + 2) += sumAvx2(sum_u);
+    unionCountWords(a + i, b + i, n - i, counts);
+}
+
+#endif
+
+static UnionCountFunc findUnionCount(void)
+{
+#ifdef BF_HAVE_AVX2
+    if (__builtin_cpu_supports("avx2")) {
+        return unionCountAvx2;
+    }
+#endif
+
+    return unionCountScalar;
+}
+
+int BitsGet(uint64_t *data, uint64_t bit_index)
+{
+    return (data[bit_index >> 6] & ((uint64_t) 1 << (bit_index & 63))) != 0;
+}
+
+//puts are allowed on owned and shared filters, but never a fuse one.
+BF_ALWAYS_INLINE int writable(const BloomFilter *bf)
+{
+    return (bf->mode == BF_MODE_OWNED || bf->mode == BF_MODE_SHARED) && bf->bitset->magic != BF_MAGIC_FUSE;
+}
+
+int BitsGetBE(const uint8_t *data, uint64_t bit_index)
+{
+    return (data[(bit_index >> 3) ^ BF_BE_BYTE_SWIZZLE] >> (bit_index & 7)) & 1;
+}
+
+//stripe of the calling thread, handed out round robin on first use.
+static __thread int counterStripe = -1;
+static int counterStripeNext = 0;
+static pthread_once_t counterStripeOnce = PTHREAD_ONCE_INIT;
+
+//a forked worker picks its own stripe of a shared filter.
+static void counterStripeReset(void)
+{
+    counterStripe = -1;
+}
+
+static void counterStripeAtFork(void)
+{
+    pthread_atfork(NULL, NULL, counterStripeReset);
+}
+
+BF_ALWAYS_INLINE int stripe(void)
+{
+    if (counterStripe < 0) {
+        counterStripe = (__atomic_fetch_add(&counterStripeNext, 1, __ATOMIC_RELAXED) + (int)getpid())
+                % BF_COUNTER_STRIPES;
+    }
+
+    return counterStripe;
+}
+
+BF_ALWAYS_INLINE void counterAdd(BloomFilter *bf, uint64_t n)
+{
+    __atomic_fetch_add(bf->counters + stripe() * BF_COUNTER_STRIDE, n, __ATOMIC_RELAXED);
+}
+
+/*
+ * Read side of ReplaceBitsetBF. A concurrent owned filter counts the
+ * threads using its longs in two reader counters per stripe, next to the
+ * stripe's bit counter, picked by the parity of the epoch they entered in.
+ * A replace flips the epoch and waits for the old parity to drain, readers
+ * never wait: they only retry if a flip lands between their two loads.
+ */
+
+BF_ALWAYS_INLINE uint64_t *readEnter(BloomFilter *bf)
+{
+    uint64_t *readers   = NULL;
+    uint64_t epoch      = 0;
+
+    if (!bf->concurrent || bf->mode != BF_MODE_OWNED) {
+        return NULL;
+    }
+
+    do {
+        if (NULL != readers) {
+            __atomic_fetch_sub(readers, 1, __ATOMIC_SEQ_CST);
+        }
+        epoch = __atomic_load_n(&bf->epoch, __ATOMIC_SEQ_CST);
+        readers = bf->counters + stripe() * BF_COUNTER_STRIDE + 1 + (epoch & 1);
+        __atomic_fetch_add(readers, 1, __ATOMIC_SEQ_CST);
+    } while (__atomic_load_n(&bf->epoch, __ATOMIC_SEQ_CST) != epoch);
+
+    return readers;
+}
+
+BF_ALWAYS_INLINE void readExit(uint64_t *readers)
+{
+    if (NULL != readers) {
+        __atomic_fetch_sub(readers, 1, __ATOMIC_RELEASE);
+    }
+}
+
+//the longs of a read section, load once after readEnter and use them
+//until readExit: a second load may see a replace, the first stays valid.
+BF_ALWAYS_INLINE uint8_t *readData(BloomFilter *bf)
+{
+    return __atomic_load_n(&bf->data, __ATOMIC_ACQUIRE);
+}
+
+//lines of BF_DIRTY_WORDS longs, one dirty bit each.
+BF_ALWAYS_INLINE uint64_t dirtyLines(const BloomFilter *bf)
+{
+    return ((uint64_t)bf->bitset->length + BF_DIRTY_WORDS - 1) / BF_DIRTY_WORDS;
+}
+
+//the overwrite bitmap follows the dirty one: lines that may have lost bits,
+//which the next delta ships as BF_DELTA_OVERWRITE ranges.
+BF_ALWAYS_INLINE uint64_t *dirtyOverwrite(const BloomFilter *bf)
+{
+    return bf->dirty + (dirtyLines(bf) + 63) / 64;
+}
+
+//mark every line dirty and overwritten, and no bit past the last one.
+static void dirtyAll(BloomFilter *bf)
+{
+    uint64_t lines = dirtyLines(bf);
+    uint64_t *bitmaps[2] = {dirtyOverwrite(bf), bf->dirty};
+
+    for (int i = 0; i < 2; i++) {
+        memset(bitmaps[i], 0xff, sizeof(uint64_t) * (lines / 64));
+        if (lines & 63) {
+            *(bitmaps[i] + lines / 64) = ((uint64_t)1 << (lines & 63)) - 1;
+        }
+    }
+}
+
+//mark the line of word, one of the longs data, for the next SerializeDelta.
+BF_ALWAYS_INLINE void dirtyMark(BloomFilter *bf, const uint8_t *data, const uint64_t *word)
+{
+    uint64_t line       = (uint64_t)(word - (const uint64_t *)data) / BF_DIRTY_WORDS;
+    uint64_t *dirty     = bf->dirty + (line >> 6);
+    uint64_t mask       = (uint64_t)1 << (line & 63);
+
+    if (__atomic_load_n(dirty, __ATOMIC_RELAXED) & mask) {
+        return;
+    }
+
+    if (bf->concurrent) {
+        __atomic_fetch_or(dirty, mask, __ATOMIC_RELAXED);
+    } else {
+        *dirty |= mask;
+    }
+}
+
+//mark the line of word, which lost bits, for the next SerializeDelta to
+//overwrite. The overwrite bit goes first, a delta seeing the dirty bit
+//sees it too.
+static void dirtyMarkCleared(BloomFilter *bf, const uint8_t *data, const uint64_t *word)
+{
+    uint64_t line       = (uint64_t)(word - (const uint64_t *)data) / BF_DIRTY_WORDS;
+
+    __atomic_fetch_or(dirtyOverwrite(bf) + (line >> 6), (uint64_t)1 << (line & 63), __ATOMIC_RELEASE);
+    dirtyMark(bf, data, word);
+}
+
+//set mask in word, one of the longs data, counting the bits that were not
+//set. 0->no bit changed.
+BF_ALWAYS_INLINE int WordsSet(BloomFilter *bf, uint8_t *data, uint64_t *word, uint64_t mask)
+{
+    uint64_t old        = 0;
+    uint64_t changed    = 0;
+
+    if (!bf->concurrent) {
+        old = *word;
+        changed = mask & ~old;
+        if (changed == 0) {
+            return 0;
+        }
+
+        *word = old | mask;
+        bf->bit_count += __builtin_popcountll(changed);
+        if (NULL != bf->dirty) {
+            dirtyMark(bf, data, word);
+        }
+
+        return 1;
+    }
+
+    if ((__atomic_load_n(word, __ATOMIC_RELAXED) & mask) == mask) {
+        return 0;
+    }
+
+    //exactly one writer sees each bit go from 0 to 1.
+    old = __atomic_fetch_or(word, mask, __ATOMIC_RELAXED);
+    changed = mask & ~old;
+    if (changed == 0) {
+        return 0;
+    }
+
+    counterAdd(bf, __builtin_popcountll(changed));
+    //after the OR: a delta that clears the mark first still sees the bit.
+    if (NULL != bf->dirty) {
+        dirtyMark(bf, data, word);
+    }
+
+    return 1;
+}
+
+//store value in word, one of the longs data, counting the bits it sets and
+//clears. 0->no bit changed.
+static int WordsStore(BloomFilter *bf, uint8_t *data, uint64_t *word, uint64_t value)
+{
+    uint64_t old        = 0;
+    uint64_t flipped    = 0;
+
+    if (bf->concurrent) {
+        old = __atomic_exchange_n(word, value, __ATOMIC_RELAXED);
+    } else {
+        old = *word;
+        *word = value;
+    }
+
+    if (old == value) {
+        return 0;
+    }
+
+    flipped = (uint64_t)__builtin_popcountll(value) - (uint64_t)__builtin_popcountll(old);
+    if (bf->concurrent) {
+        counterAdd(bf, flipped);
+    } else {
+        bf->bit_count += flipped;
+    }
+
+    if (NULL != bf->dirty) {
+        if (old & ~value) {
+            dirtyMarkCleared(bf, data, word);
+        } else {
+            dirtyMark(bf, data, word);
+        }
+    }
+
+    return 1;
+}
+
+int BitsSet(BloomFilter *bf, uint8_t *data, uint64_t bit_index)
+{
+    return WordsSet(bf, data, (uint64_t *)data + (bit_index >> 6), (uint64_t)1 << (bit_index & 63));
+}
+
+/*
+ * Index derivation strategies, picked by BitSetHeader.magic. The probe
+ * loops are always inlined with a constant strategy and hash number, so
+ * each kernel gets its own unrolled loop with the index arithmetic folded
+ * in. Kernel 0 of a strategy reads hash_num at runtime. The longs come
+ * in as data, loaded once by the caller's read section.
+ */
+
+struct BFStrategy {
+    int8_t magic;
+
+    //set the probes of h1/h2 in data, 0->no bit changed.
+    int (*put)(BloomFilter *bf, uint8_t *data, uint64_t h1, uint64_t h2);
+
+    //0->not in. 1->in.
+    int (*contain)(const BloomFilter *bf, const uint8_t *data, uint64_t h1, uint64_t h2);
+
+    //the first n bit indexes of h1/h2.
+    void (*indexes)(const BloomFilter *bf, const uint8_t *data, uint64_t h1, uint64_t h2, uint64_t *probes, int n);
+
+    //0->length longs are not a layout of magic, the probes would run past.
+    int (*fits)(uint32_t length);
+};
+
+BF_ALWAYS_INLINE uint64_t probeIndex(int8_t magic, uint64_t combine, uint64_t bit_size)
+{
+    switch (magic) {
+        case BF_MAGIC_FASTRANGE:
+            return (uint64_t)(((unsigned __int128)combine * bit_size) >> 64);
+        case BF_MAGIC_POW2:
+            return combine & (bit_size - 1);
+        default:
+            return (combine & INT64_MAX) % bit_size;
+    }
+}
+
+//an odd step walks all of a power of two bitset before repeating.
+BF_ALWAYS_INLINE uint64_t probeStep(int8_t magic, uint64_t h2)
+{
+    return magic == BF_MAGIC_POW2 ? h2 | 1 : h2;
+}
+
+BF_ALWAYS_INLINE int probePut(BloomFilter *bf, uint8_t *data, uint64_t h1, uint64_t h2, int8_t magic, int k)
+{
+    uint64_t bit_size   = (uint64_t)bf->bitset->length * 64;
+    uint64_t step       = probeStep(magic, h2);
+    uint64_t combine    = h1;
+    int hash_num        = k ? k : bf->bitset->hash_num;
+    int bits_changed    = 0;
+
+#pragma GCC unroll 16
+    for (int i = 0; i < hash_num; i++) {
+        bits_changed |= BitsSet(bf, data, probeIndex(magic, combine, bit_size));
+        combine += step;
+    }
+
+    return bits_changed;
+}
+
+BF_ALWAYS_INLINE int probeContain(const BloomFilter *bf, const uint8_t *data, uint64_t h1, uint64_t h2,
+                                  int8_t magic, int k)
+{
+    uint64_t bit_size   = (uint64_t)bf->bitset->length * 64;
+    uint64_t step       = probeStep(magic, h2);
+    uint64_t combine    = h1;
+    int hash_num        = k ? k : bf->bitset->hash_num;
+
+    if (bf->mode == BF_MODE_VIEW) {
+#pragma GCC unroll 16
+        for (int i = 0; i < hash_num; i++) {
+            if (!BitsGetBE(data, probeIndex(magic, combine, bit_size))) {
+                return 0;
+            }
+            combine += step;
+        }
+
+        return 1;
+    }
+
+#pragma GCC unroll 16
+    for (int i = 0; i < hash_num; i++) {
+        if (!BitsGet((uint64_t *)data, probeIndex(magic, combine, bit_size))) {
+            return 0;
+        }
+        combine += step;
+    }
+
+    return 1;
+}
+
+BF_ALWAYS_INLINE void probeIndexes(const BloomFilter *bf, uint64_t h1, uint64_t h2,
+                                   uint64_t *probes, int n, int8_t magic)
+{
+    uint64_t bit_size   = (uint64_t)bf->bitset->length * 64;
+    uint64_t step       = probeStep(magic, h2);
+    uint64_t combine    = h1;
+
+    for (int i = 0; i < n; i++) {
+        *(probes + i) = probeIndex(magic, combine, bit_size);
+        combine += step;
+    }
+}
+
+BF_ALWAYS_INLINE int putGuava(BloomFilter *bf, uint8_t *data, uint64_t h1, uint64_t h2, int k)
+{
+    return probePut(bf, data, h1, h2, BF_MAGIC_GUAVA, k);
+}
+
+BF_ALWAYS_INLINE int containGuava(const BloomFilter *bf, const uint8_t *data, uint64_t h1, uint64_t h2, int k)
+{
+    return probeContain(bf, data, h1, h2, BF_MAGIC_GUAVA, k);
+}
+
+static int fitsProbe(uint32_t length)
+{
+    return length > 0;
+}
+
+static void indexesGuava(const BloomFilter *bf, const uint8_t *data, uint64_t h1, uint64_t h2,
+                        uint64_t *probes, int n)
+{
+    probeIndexes(bf, h1, h2, probes, n, BF_MAGIC_GUAVA);
+}
+
+BF_ALWAYS_INLINE int putFastRange(BloomFilter *bf, uint8_t *data, uint64_t h1, uint64_t h2, int k)
+{
+    return probePut(bf, data, h1, h2, BF_MAGIC_FASTRANGE, k);
+}
+
+BF_ALWAYS_INLINE int containFastRange(const BloomFilter *bf, const uint8_t *data, uint64_t h1, uint64_t h2, int k)
+{
+    return probeContain(bf, data, h1, h2, BF_MAGIC_FASTRANGE, k);
+}
+
+static void indexesFastRange(const BloomFilter *bf, const uint8_t *data, uint64_t h1, uint64_t h2,
+                        uint64_t *probes, int n)
+{
+    probeIndexes(bf, h1, h2, probes, n, BF_MAGIC_FASTRANGE);
+}
+
+BF_ALWAYS_INLINE int putPow2(BloomFilter *bf, uint8_t *data, uint64_t h1, uint64_t h2, int k)
+{
+    return probePut(bf, data, h1, h2, BF_MAGIC_POW2, k);
+}
+
+BF_ALWAYS_INLINE int containPow2(const BloomFilter *bf, const uint8_t *data, uint64_t h1, uint64_t h2, int k)
+{
+    return probeContain(bf, data, h1, h2, BF_MAGIC_POW2, k);
+}
+
+//probeIndex masks with bit_size - 1, a power of two longs keeps it exact.
+static int fitsPow2(uint32_t length)
+{
+    return length > 0 && (length & (length - 1)) == 0;
+}
+
+static void indexesPow2(const BloomFilter *bf, const uint8_t *data, uint64_t h1, uint64_t h2,
+                        uint64_t *probes, int n)
+{
+    probeIndexes(bf, h1, h2, probes, n, BF_MAGIC_POW2);
+}
+
+/*
+ * Blocked layout: h1 picks one BF_BLOCK_BITS block, and every probe of the
+ * key lands in it, bit i at the top 9 bits of h2 * BF_BLOCK_REHASH^i.
+ */
+
+//whole blocks only, blockBase picks among length / BF_BLOCK_WORDS.
+static int fitsBlocked(uint32_t length)
+{
+    return length >= BF_BLOCK_WORDS && length % BF_BLOCK_WORDS == 0;
+}
+
+BF_ALWAYS_INLINE uint64_t blockBase(const BloomFilter *bf, uint64_t h1)
+{
+    uint64_t blocks = (uint64_t)bf->bitset->length / BF_BLOCK_WORDS;
+
+    return (uint64_t)(((unsigned __int128)h1 * blocks) >> 64) * BF_BLOCK_BITS;
+}
+
+//the probes of h2 as one mask per long of the block.
+BF_ALWAYS_INLINE void blockMasks(int hash_num, uint64_t h2, uint64_t *masks)
+{
+    for (int i = 0; i < BF_BLOCK_WORDS; i++) {
+        *(masks + i) = 0;
+    }
+
+#pragma GCC unroll 16
+    for (int i = 0; i < hash_num; i++) {
+        uint64_t bit = h2 >> 55;
+
+        *(masks + (bit >> 6)) |= (uint64_t)1 << (bit & 63);
+        h2 *= BF_BLOCK_REHASH;
+    }
+}
+
+BF_ALWAYS_INLINE int putBlocked(BloomFilter *bf, uint8_t *data, uint64_t h1, uint64_t h2, int k)
+{
+    uint64_t masks[BF_BLOCK_WORDS];
+    uint64_t *block     = (uint64_t *)data + blockBase(bf, h1) / 64;
+    int bits_changed    = 0;
+
+    blockMasks(k ? k : bf->bitset->hash_num, h2, masks);
+
+    for (int i = 0; i < BF_BLOCK_WORDS; i++) {
+        if (masks[i] != 0) {
+            bits_changed |= WordsSet(bf, data, block + i, masks[i]);
+        }
+    }
+
+    return bits_changed;
+}
+
+BF_ALWAYS_INLINE int containBlocked(const BloomFilter *bf, const uint8_t *data, uint64_t h1, uint64_t h2, int k)
+{
+    uint64_t masks[BF_BLOCK_WORDS];
+    uint64_t base       = blockBase(bf, h1);
+    const uint64_t *block = (const uint64_t *)data + base / 64;
+    uint64_t missing    = 0;
+    int hash_num        = k ? k : bf->bitset->hash_num;
+
+    if (bf->mode == BF_MODE_VIEW) {
+        for (int i = 0; i < hash_num; i++) {
+            if (!BitsGetBE(data, base + (h2 >> 55))) {
+                return 0;
+            }
+            h2 *= BF_BLOCK_REHASH;
+        }
+
+        return 1;
+    }
+
+    blockMasks(hash_num, h2, masks);
+
+    //one cache line, no branch per probe.
+    for (int i = 0; i < BF_BLOCK_WORDS; i++) {
+        missing |= masks[i] & ~*(block + i);
+    }
+
+    return missing == 0;
+}
+
+static void indexesBlocked(const BloomFilter *bf, const uint8_t *data, uint64_t h1, uint64_t h2,
+                           uint64_t *probes, int n)
+{
+    uint64_t base = blockBase(bf, h1);
+
+    for (int i = 0; i < n; i++) {
+        *(probes + i) = base + (h2 >> 55);
+        h2 *= BF_BLOCK_REHASH;
+    }
+}
+
+/*
+ * Split block layout (Parquet/Impala SBBF): the high half of h1 picks one
+ * BF_SPLIT_BLOCK_BITS block, and each of its 8 32 bit lanes gets one bit,
+ * (lo32(h1) * salt[i]) >> 27. Lane i is the (i & 1) half of long i >> 1.
+ */
+
+static const uint32_t splitBlockSalts[8] = {
+    0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+    0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U,
+};
+
+//whole blocks only, splitBlockBase picks among length / BF_SPLIT_BLOCK_WORDS.
+static int fitsSplitBlock(uint32_t length)
+{
+    return length >= BF_SPLIT_BLOCK_WORDS && length % BF_SPLIT_BLOCK_WORDS == 0;
+}
+
+BF_ALWAYS_INLINE uint64_t splitBlockBase(const BloomFilter *bf, uint64_t h1)
+{
+    uint64_t blocks = (uint64_t)bf->bitset->length / BF_SPLIT_BLOCK_WORDS;
+
+    return (((h1 >> 32) * blocks) >> 32) * BF_SPLIT_BLOCK_BITS;
+}
+
+//the 8 lane bits of h1 as one mask per long of the block.
+BF_ALWAYS_INLINE void splitBlockMasks(uint64_t h1, uint64_t *masks)
+{
+    uint32_t key = (uint32_t)h1;
+
+    for (int i = 0; i < BF_SPLIT_BLOCK_WORDS; i++) {
+        uint32_t lo = (key * splitBlockSalts[2 * i]) >> 27;
+        uint32_t hi = (key * splitBlockSalts[2 * i + 1]) >> 27;
+
+        *(masks + i) = ((uint64_t)1 << lo) | ((uint64_t)1 << (hi + 32));
+    }
+}
+
+static int putSplitBlock(BloomFilter *bf, uint8_t *data, uint64_t h1, uint64_t h2)
+{
+    uint64_t masks[BF_SPLIT_BLOCK_WORDS];
+    uint64_t *block     = (uint64_t *)data + splitBlockBase(bf, h1) / 64;
+    int bits_changed    = 0;
+
+    splitBlockMasks(h1, masks);
+
+    for (int i = 0; i < BF_SPLIT_BLOCK_WORDS; i++) {
+        bits_changed |= WordsSet(bf, data, block + i, masks[i]);
+    }
+
+    return bits_changed;
+}
+
+static int containSplitBlock(const BloomFilter *bf, const uint8_t *data, uint64_t h1, uint64_t h2)
+{
+    uint64_t masks[BF_SPLIT_BLOCK_WORDS];
+    uint64_t base       = splitBlockBase(bf, h1);
+    const uint64_t *block = (const uint64_t *)data + base / 64;
+    uint64_t missing    = 0;
+
+    splitBlockMasks(h1, masks);
+
+    if (bf->mode == BF_MODE_VIEW) {
+        for (int i = 0; i < BF_SPLIT_BLOCK_WORDS; i++) {
+            uint64_t word = 0;
+
+            memcpy(&word, (const uint8_t *)block + i * sizeof(uint64_t), sizeof(uint64_t));
+            missing |= masks[i] & ~BF_NTOHLL(word);
+        }
+
+        return missing == 0;
+    }
+
+    for (int i = 0; i < BF_SPLIT_BLOCK_WORDS; i++) {
+        missing |= masks[i] & ~*(block + i);
+    }
+
+    return missing == 0;
+}
+
+static void indexesSplitBlock(const BloomFilter *bf, const uint8_t *data, uint64_t h1, uint64_t h2,
+                              uint64_t *probes, int n)
+{
+    uint64_t base = splitBlockBase(bf, h1);
+    uint32_t key  = (uint32_t)h1;
+
+    for (int i = 0; i < n && i < 8; i++) {
+        *(probes + i) = base + i * 32 + ((key * splitBlockSalts[i]) >> 27);
+    }
+}
+
+#ifdef BF_HAVE_AVX2
+
+__attribute__((target("avx2")))
+static inline __m256i splitBlockMaskAvx2(uint64_t h1)
+{
+    const __m256i salts = _mm256_loadu_si256((const __m256i *)splitBlockSalts);
+    __m256i lanes       = _mm256_mullo_epi32(_mm256_set1_epi32((int)(uint32_t)h1), salts);
+
+    lanes = _mm256_srli_epi32(lanes, 27);
+
+    return _mm256_sllv_epi32(_mm256_set1_epi32(1), lanes);
+}
+
+__attribute__((target("avx2,popcnt")))
+static int putSplitBlockAvx2(BloomFilter *bf, uint8_t *data, uint64_t h1, uint64_t h2)
+{
+    __m256i *block  = (__m256i *)((uint64_t *)data + splitBlockBase(bf, h1) / 64);
+    __m256i mask    = splitBlockMaskAvx2(h1);
+    __m256i old;
+    __m256i changed;
+
+    //a 256 bit store is not atomic, concurrent writers OR long by long.
+    if (bf->concurrent) {
+        return putSplitBlock(bf, data, h1, h2);
+    }
+
+    old = _mm256_loadu_si256(block);
+    changed = _mm256_andnot_si256(old, mask);
+    if (_mm256_testz_si256(changed, changed)) {
+        return 0;
+    }
+
+    _mm256_storeu_si256(block, _mm256_or_si256(old, mask));
+    bf->bit_count += _mm_popcnt_u64((uint64_t)_mm256_extract_epi64(changed, 0))
+            + _mm_popcnt_u64((uint64_t)_mm256_extract_epi64(changed, 1))
+            + _mm_popcnt_u64((uint64_t)_mm256_extract_epi64(changed, 2))
+            + _mm_popcnt_u64((uint64_t)_mm256_extract_epi64(changed, 3));
+    //a block is half a line.
+    if (NULL != bf->dirty) {
+        dirtyMark(bf, data, (const uint64_t *)block);
+    }
+
+    return 1;
+}
+
+__attribute__((target("avx2")))
+static int containSplitBlockAvx2(const BloomFilter *bf, const uint8_t *data, uint64_t h1, uint64_t h2)
+{
+    const __m256i *block = (const __m256i *)((const uint64_t *)data + splitBlockBase(bf, h1) / 64);
+
+    if (bf->mode == BF_MODE_VIEW) {
+        return containSplitBlock(bf, data, h1, h2);
+    }
+
+    return _mm256_testc_si256(_mm256_loadu_si256(block), splitBlockMaskAvx2(h1));
+}
+
+#endif
+
+/*
+ * Kernels, one per strategy and hash number 0..BF_KERNEL_MAX_HASH.
+ */
+
+#define BF_DEFINE_KERNEL(name, k)                                                           \
+static int put##name##k(BloomFilter *bf, uint8_t *data, uint64_t h1, uint64_t h2)           \
+{                                                                                           \
+    return put##name(bf, data, h1, h2, k);                                                  \
+}                                                                                           \
+static int contain##name##k(const BloomFilter *bf, const uint8_t *data,                     \
+                            uint64_t h1, uint64_t h2)                                       \
+{                                                                                           \
+    return contain##name(bf, data, h1, h2, k);                                              \
+}
+
+#define BF_DEFINE_KERNELS(name)                                                             \
+    BF_DEFINE_KERNEL(name, 0)   BF_DEFINE_KERNEL(name, 1)   BF_DEFINE_KERNEL(name, 2)       \
+    BF_DEFINE_KERNEL(name, 3)   BF_DEFINE_KERNEL(name, 4)   BF_DEFINE_KERNEL(name, 5)       \
+    BF_DEFINE_KERNEL(name, 6)   BF_DEFINE_KERNEL(name, 7)   BF_DEFINE_KERNEL(name, 8)       \
+    BF_DEFINE_KERNEL(name, 9)   BF_DEFINE_KERNEL(name, 10)  BF_DEFINE_KERNEL(name, 11)      \
+    BF_DEFINE_KERNEL(name, 12)  BF_DEFINE_KERNEL(name, 13)  BF_DEFINE_KERNEL(name, 14)      \
+    BF_DEFINE_KERNEL(name, 15)  BF_DEFINE_KERNEL(name, 16)
+
+#define BF_KERNEL(name, magic, fits, k)                                                     \
+    {magic, put##name##k, contain##name##k, indexes##name, fits}
+
+#define BF_KERNELS(name, magic, fits)                                                       \
+    BF_KERNEL(name, magic, fits, 0),    BF_KERNEL(name, magic, fits, 1),                    \
+    BF_KERNEL(name, magic, fits, 2),    BF_KERNEL(name, magic, fits, 3),                    \
+    BF_KERNEL(name, magic, fits, 4),    BF_KERNEL(name, magic, fits, 5),                    \
+    BF_KERNEL(name, magic, fits, 6),    BF_KERNEL(name, magic, fits, 7),                    \
+    BF_KERNEL(name, magic, fits, 8),    BF_KERNEL(name, magic, fits, 9),                    \
+    BF_KERNEL(name, magic, fits, 10),   BF_KERNEL(name, magic, fits, 11),                   \
+    BF_KERNEL(name, magic, fits, 12),   BF_KERNEL(name, magic, fits, 13),                   \
+    BF_KERNEL(name, magic, fits, 14),   BF_KERNEL(name, magic, fits, 15),                   \
+    BF_KERNEL(name, magic, fits, 16)
+
+BF_DEFINE_KERNELS(Guava)
+BF_DEFINE_KERNELS(FastRange)
+BF_DEFINE_KERNELS(Pow2)
+BF_DEFINE_KERNELS(Blocked)
+
+static const struct BFStrategy guavaKernels[] = {BF_KERNELS(Guava, BF_MAGIC_GUAVA, fitsProbe)};
+static const struct BFStrategy fastRangeKernels[] = {BF_KERNELS(FastRange, BF_MAGIC_FASTRANGE, fitsProbe)};
+static const struct BFStrategy pow2Kernels[] = {BF_KERNELS(Pow2, BF_MAGIC_POW2, fitsPow2)};
+static const struct BFStrategy blockedKernels[] = {BF_KERNELS(Blocked, BF_MAGIC_BLOCKED, fitsBlocked)};
+
+/*
+ * Binary fuse: the longs hold BF_FUSE_PARAMS params, then a byte of
+ * fingerprint per slot. A key is in when the fingerprints of its 3 slots
+ * xor to its own. Slot bytes are read through the byte swizzle, so a view
+ * of the big endian longs queries in place.
+ */
+
+BF_ALWAYS_INLINE uint64_t fuseParam(const BloomFilter *bf, const uint8_t *data, int i)
+{
+    uint64_t param = 0;
+
+    memcpy(&param, data + i * sizeof(uint64_t), sizeof(uint64_t));
+
+    return bf->mode == BF_MODE_VIEW ? BF_NTOHLL(param) : param;
+}
+
+BF_ALWAYS_INLINE uint64_t fuseMix(uint64_t h1, uint64_t seed)
+{
+    uint64_t h = h1 + seed;
+
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+
+    return h;
+}
+
+BF_ALWAYS_INLINE uint8_t fuseFingerprint(uint64_t hash)
+{
+    return (uint8_t)(hash ^ (hash >> 32));
+}
+
+//the 3 slots of hash, one in each of 3 consecutive segments.
+BF_ALWAYS_INLINE void fuseSlots(uint64_t hash, uint64_t segment_length, uint64_t segment_count_length,
+                                uint64_t *slots)
+{
+    uint64_t mask = segment_length - 1;
+
+    *slots = (uint64_t)(((unsigned __int128)hash * segment_count_length) >> 64);
+    *(slots + 1) = (*slots + segment_length) ^ ((hash >> 18) & mask);
+    *(slots + 2) = (*slots + 2 * segment_length) ^ (hash & mask);
+}
+
+//0->params a blob could carry, but that probe past the longs.
+BF_ALWAYS_INLINE int fuseParamsValid(const BloomFilter *bf, uint64_t segment_length, uint64_t segment_count_length)
+{
+    uint64_t bytes = ((uint64_t)bf->bitset->length - BF_FUSE_PARAMS) * sizeof(uint64_t);
+
+    return bf->bitset->length > BF_FUSE_PARAMS
+        && segment_length != 0 && (segment_length & (segment_length - 1)) == 0
+        && segment_count_length % segment_length == 0
+        && segment_count_length <= bytes && bytes - segment_count_length >= 2 * segment_length;
+}
+
+BF_ALWAYS_INLINE uint8_t fuseSlot(const BloomFilter *bf, const uint8_t *data, uint64_t slot)
+{
+    uint64_t byte = BF_FUSE_PARAMS * sizeof(uint64_t) + slot;
+
+    return bf->mode == BF_MODE_VIEW ? *(data + (byte ^ BF_BE_BYTE_SWIZZLE)) : *(data + byte);
+}
+
+static int putFuse(BloomFilter *bf, uint8_t *data, uint64_t h1, uint64_t h2)
+{
+    return 0;
+}
+
+static int containFuse(const BloomFilter *bf, const uint8_t *data, uint64_t h1, uint64_t h2)
+{
+    uint64_t segment_length         = fuseParam(bf, data, 1);
+    uint64_t segment_count_length   = fuseParam(bf, data, 2);
+    uint64_t hash                   = fuseMix(h1, fuseParam(bf, data, 0));
+    uint64_t slots[BF_FUSE_ARITY];
+
+    if (!fuseParamsValid(bf, segment_length, segment_count_length)) {
+        return 0;
+    }
+
+    fuseSlots(hash, segment_length, segment_count_length, slots);
+
+    return (fuseFingerprint(hash) ^ fuseSlot(bf, data, *slots) ^ fuseSlot(bf, data, *(slots + 1))
+            ^ fuseSlot(bf, data, *(slots + 2))) == 0;
+}
+
+//bit indexes of the 3 slot bytes, for the batch prefetch.
+static void indexesFuse(const BloomFilter *bf, const uint8_t *data, uint64_t h1, uint64_t h2,
+                        uint64_t *probes, int n)
+{
+    uint64_t segment_length         = fuseParam(bf, data, 1);
+    uint64_t segment_count_length   = fuseParam(bf, data, 2);
+    uint64_t slots[BF_FUSE_ARITY];
+
+    if (!fuseParamsValid(bf, segment_length, segment_count_length)) {
+        segment_length = 1;
+        segment_count_length = 0;
+    }
+
+    fuseSlots(fuseMix(h1, fuseParam(bf, data, 0)), segment_length, segment_count_length, slots);
+
+    for (int i = 0; i < n && i < BF_FUSE_ARITY; i++) {
+        *(probes + i) = (BF_FUSE_PARAMS * sizeof(uint64_t) + *(slots + i)) * 8;
+    }
+}
+
+//the params and a slot at least, containFuse checks the params themselves.
+static int fitsFuse(uint32_t length)
+{
+    return length > BF_FUSE_PARAMS;
+}
+
+static const struct BFStrategy fuseKernel = {
+    BF_MAGIC_FUSE, putFuse, containFuse, indexesFuse, fitsFuse
+};
+
+static const struct BFStrategy splitBlockKernel = {
+    BF_MAGIC_SPLIT_BLOCK, putSplitBlock, containSplitBlock, indexesSplitBlock, fitsSplitBlock
+};
+
+#ifdef BF_HAVE_AVX2
+static const struct BFStrategy splitBlockAvx2Kernel = {
+    BF_MAGIC_SPLIT_BLOCK, putSplitBlockAvx2, containSplitBlockAvx2, indexesSplitBlock, fitsSplitBlock
+};
+#endif
+
+//the kernel of magic unrolled for hash_num, once per filter. NULL->unknown magic.
+const struct BFStrategy *findStrategy(int8_t magic, int hash_num)
+{
+    const struct BFStrategy *kernels = NULL;
+
+    switch (magic) {
+        case BF_MAGIC_GUAVA:
+            kernels = guavaKernels;
+            break;
+        case BF_MAGIC_FASTRANGE:
+            kernels = fastRangeKernels;
+            break;
+        case BF_MAGIC_POW2:
+            kernels = pow2Kernels;
+            break;
+        case BF_MAGIC_BLOCKED:
+            kernels = blockedKernels;
+            break;
+        case BF_MAGIC_SPLIT_BLOCK:
+#ifdef BF_HAVE_AVX2
+            if (__builtin_cpu_supports("avx2")) {
+                return &splitBlockAvx2Kernel;
+            }
+#endif
+            return &splitBlockKernel;
+        case BF_MAGIC_FUSE:
+            return &fuseKernel;
+        default:
+            return NULL;
+    }
+
+    return hash_num <= BF_KERNEL_MAX_HASH ? kernels + hash_num : kernels;
+}
+
+//the kernel of a stored header. NULL->unknown magic, or length longs the
+//kernel would probe past.
+static const struct BFStrategy *loadStrategy(int8_t magic, int hash_num, uint32_t length)
+{
+    const struct BFStrategy *strategy = findStrategy(magic, hash_num);
+
+    return NULL != strategy && strategy->fits(length) ? strategy : NULL;
+}
+
+//4 independent lanes, lane i & 3 takes long i.
+void checksumUpdate(uint64_t *lanes, uint64_t offset, const uint64_t *words, uint64_t n)
+{
+    for (uint64_t i = 0; i < n; i++) {
+        uint64_t *lane = lanes + ((offset + i) & 3);
+        uint64_t h = (*lane ^ *(words + i)) * BF_CHECKSUM_PRIME;
+
+        *lane = (h << 29) | (h >> 35);
+    }
+}
+
+uint64_t checksumFinal(uint64_t *lanes, uint64_t length)
+{
+    uint64_t h = length;
+
+    for (int i = 0; i < 4; i++) {
+        h = (h ^ *(lanes + i)) * BF_CHECKSUM_PRIME;
+        h ^= h >> 32;
+    }
+
+    return h;
+}
+
+//n host order longs of data, bf's longs, from index, copied to buf if needed.
+const uint64_t *hostWords(BloomFilter *bf, const uint8_t *data, uint64_t index, uint64_t n, uint64_t *buf)
+{
+    if (bf->mode != BF_MODE_VIEW) {
+        return (const uint64_t *)data + index;
+    }
+
+    findSwapCount()(buf, data + index * sizeof(uint64_t), n);
+
+    return buf;
+}
+
+uint64_t OptimalNumOfBits(uint64_t n, double p)
+{
+    if (p == 0) {
+        p = 4.940656458412465441765687928682213723651e-324;
+    }
+
+    return (uint64_t)(-1 * (double)n * log(p) / (log(2) * log(2)));
+}
+
+//TODO:check
+int OptimalNumOfHash(uint64_t n, uint64_t m)
+{
+    return (int)(fmax(1, floor(((double)(m / n) * log(2)) + 0.5)));
+}
+
+//keys per block are poisson(n * BF_BLOCK_BITS / m), each block a small
+//standard bloom of BF_BLOCK_BITS bits.
+double blockedFpp(uint64_t n, uint64_t m, int k)
+{
+    double lambda   = (double)n * BF_BLOCK_BITS / (double)m;
+    double term     = exp(-lambda);
+    double fpp      = 0;
+    int max_keys    = (int)(lambda + 10 * sqrt(lambda) + 10);
+
+    for (int i = 0; i <= max_keys; i++) {
+        if (i > 0) {
+            term *= lambda / i;
+        }
+        fpp += term * pow(1 - pow(1 - 1.0 / BF_BLOCK_BITS, (double)k * i), k);
+    }
+
+    return fpp;
+}
+
+//like blockedFpp, but each of the 8 lanes of a block is a 32 bit bloom
+//with one bit per key.
+double splitBlockFpp(uint64_t n, uint64_t m)
+{
+    double lambda   = (double)n * BF_SPLIT_BLOCK_BITS / (double)m;
+    double term     = exp(-lambda);
+    double fpp      = 0;
+    int max_keys    = (int)(lambda + 10 * sqrt(lambda) + 10);
+
+    for (int i = 0; i <= max_keys; i++) {
+        if (i > 0) {
+            term *= lambda / i;
+        }
+        fpp += term * pow(1 - pow(1 - 1.0 / 32, (double)i), 8);
+    }
+
+    return fpp;
+}
+
+//0 when p is out of range or no size under BF_MAX_GROW_BITS meets it.
+uint64_t optimalSplitBlockBits(uint64_t n, double p)
+{
+    uint64_t m = 0;
+
+    if (!(p > 0)) {
+        return 0;
+    }
+
+    m = OptimalNumOfBits(n, p);
+
+    m = (m + BF_SPLIT_BLOCK_BITS - 1) / BF_SPLIT_BLOCK_BITS * BF_SPLIT_BLOCK_BITS;
+    if (m == 0) {
+        m = BF_SPLIT_BLOCK_BITS;
+    }
+
+    while (n > 0 && m <= BF_MAX_GROW_BITS && splitBlockFpp(n, m) > p) {
+        m = (m + m / 32 + BF_SPLIT_BLOCK_BITS) / BF_SPLIT_BLOCK_BITS * BF_SPLIT_BLOCK_BITS;
+    }
+
+    if (m > BF_MAX_GROW_BITS) {
+        return 0;
+    }
+
+    return m;
+}
+
+//grow m past OptimalNumOfBits until the blocked fpp meets p, 0 as
+//optimalSplitBlockBits.
+uint64_t optimalBlockedBits(uint64_t n, double p, int *hash_num)
+{
+    uint64_t m = 0;
+
+    if (!(p > 0)) {
+        return 0;
+    }
+
+    m = OptimalNumOfBits(n, p);
+
+    m = (m + BF_BLOCK_BITS - 1) / BF_BLOCK_BITS * BF_BLOCK_BITS;
+    if (m == 0) {
+        m = BF_BLOCK_BITS;
+    }
+
+    while (m <= BF_MAX_GROW_BITS) {
+        double best_fpp = 1;
+
+        for (int k = 1; k <= BF_BLOCK_MAX_HASH; k++) {
+            double fpp = blockedFpp(n, m, k);
+
+            if (fpp < best_fpp) {
+                best_fpp = fpp;
+                *hash_num = k;
+            }
+        }
+
+        if (best_fpp <= p || n == 0) {
+            return m;
+        }
+
+        m = (m + m / 32 + BF_BLOCK_BITS) / BF_BLOCK_BITS * BF_BLOCK_BITS;
+    }
+
+    return 0;
+}
+
+uint8_t * Serialized(BloomFilter *bf)
+{
+    int8_t magic                = 0;
+    uint8_t hash_num            = 0;
+    uint32_t length             = 0;
+    uint8_t *buf                = NULL;
+    uint64_t *data              = NULL;
+
+    if (bf == NULL || bf->mode != BF_MODE_OWNED) {
+        return NULL;
+    }
+
+    //the header of the allocation, bitset is a copy.
+    buf = bf->data - HEADER_LEN;
+
+    data = (uint64_t *)bf->data;
+    magic = bf->bitset->magic;
+    hash_num = bf->bitset->hash_num;
+    length = bf->bitset->length;
+
+    *buf = magic;
+    *(buf + 1) = hash_num;
+    BF_HTONL_ARRAY((buf + 2), length);
+
+    findSwapCount()(buf + HEADER_LEN, data, length);
+
+    data = NULL;
+
+    return buf;
+}
+
+size_t SerializedSize(BloomFilter *bf)
+{
+    if (NULL == bf || NULL == bf->bitset) {
+        return 0;
+    }
+
+    return HEADER_LEN + (size_t)bf->bitset->length * sizeof(uint64_t);
+}
+
+size_t SerializeInto(BloomFilter *bf, uint8_t *buf, size_t buf_len)
+{
+    uint64_t *readers           = NULL;
+    uint32_t length             = 0;
+    uint32_t be_length          = 0;
+    size_t size                 = SerializedSize(bf);
+
+    if (size == 0 || NULL == buf || buf_len < size) {
+        return 0;
+    }
+
+    //a view already holds the wire format.
+    if (bf->mode == BF_MODE_VIEW) {
+        memcpy(buf, bf->data - HEADER_LEN, size);
+        return size;
+    }
+
+    length = bf->bitset->length;
+    be_length = BF_HTONL(length);
+
+    *buf = bf->bitset->magic;
+    *(buf + 1) = bf->bitset->hash_num;
+    memcpy(buf + 2, &be_length, sizeof(uint32_t));
+
+    //one streaming pass, the live words are only read.
+    readers = readEnter(bf);
+    findSwapCount()(buf + HEADER_LEN, readData(bf), length);
+    readExit(readers);
+
+    return size;
+}
+
+/*
+ * Sparse wire format, for young filters that are mostly zeros:
+ *  [int8 BF_SPARSE_MAGIC][int8 magic][uint8 hash_num][uint32 BE length]
+ * then every set bit, lowest first, as the LEB128 varint of its gap: the
+ * zeros since the previous one. The blob ends with the last gap.
+ */
+
+BF_ALWAYS_INLINE size_t varintPut(uint8_t *buf, uint64_t value)
+{
+    size_t n = 0;
+
+    while (value >= 0x80) {
+        *(buf + n++) = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    *(buf + n++) = (uint8_t)value;
+
+    return n;
+}
+
+//0->truncated or longer than 64 bits.
+BF_ALWAYS_INLINE int varintGet(const uint8_t *buf, size_t buf_len, size_t *offset, uint64_t *value)
+{
+    uint64_t v  = 0;
+
+    for (int shift = 0; shift < 64 && *offset < buf_len; shift += 7) {
+        uint8_t byte = *(buf + (*offset)++);
+
+        v |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            *value = v;
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+size_t SerializeCompact(BloomFilter *bf, uint8_t *buf, size_t buf_len)
+{
+    uint64_t *readers           = NULL;
+    const uint8_t *data         = NULL;
+    uint64_t word_buf[BF_FILE_CHUNK];
+    uint32_t length             = 0;
+    uint32_t be_length          = 0;
+    uint64_t next               = 0;
+    size_t size                 = SerializedSize(bf);
+    size_t offset               = BF_SPARSE_HEADER_LEN;
+    int dense                   = 0;
+
+    if (size == 0 || NULL == buf || buf_len < size) {
+        return 0;
+    }
+
+    //every set bit takes a byte or more, past that the raw longs win.
+    if (BitCountBF(bf) >= size - BF_SPARSE_HEADER_LEN) {
+        return SerializeInto(bf, buf, buf_len);
+    }
+
+    length = bf->bitset->length;
+    be_length = BF_HTONL(length);
+
+    readers = readEnter(bf);
+    data = readData(bf);
+
+    for (uint64_t i = 0; i < length && !dense; i += BF_FILE_CHUNK) {
+        uint64_t n = length - i < BF_FILE_CHUNK ? length - i : BF_FILE_CHUNK;
+        const uint64_t *words = hostWords(bf, data, i, n, word_buf);
+
+        for (uint64_t j = 0; j < n && !dense; j++) {
+            uint64_t word = *(words + j);
+
+            while (word != 0) {
+                uint64_t bit = (i + j) * 64 + __builtin_ctzll(word);
+
+                //room for a longest varint, and still smaller than raw.
+                if (offset + 10 >= size) {
+                    dense = 1;
+                    break;
+                }
+
+                offset += varintPut(buf + offset, bit - next);
+                next = bit + 1;
+                word &= word - 1;
+            }
+        }
+    }
+
+    readExit(readers);
+
+    if (dense) {
+        return SerializeInto(bf, buf, buf_len);
+    }
+
+    *buf = BF_SPARSE_MAGIC;
+    *(buf + 1) = bf->bitset->magic;
+    *(buf + 2) = bf->bitset->hash_num;
+    memcpy(buf + 3, &be_length, sizeof(uint32_t));
+
+    return offset;
+}
+
+//decode a sparse blob straight into a new owned bitset.
+static BloomFilter *loadSparse(const uint8_t *buf, size_t buf_len)
+{
+    const struct BFStrategy *strategy   = NULL;
+    BloomFilter *bloomFilter            = NULL;
+    BitSetHeader *bitset                = NULL;
+    uint64_t *data                      = NULL;
+    uint64_t bitcount                   = 0;
+    uint64_t next                       = 0;
+    uint32_t length                     = 0;
+    size_t offset                       = BF_SPARSE_HEADER_LEN;
+
+    if (buf_len < BF_SPARSE_HEADER_LEN) {
+        return NULL;
+    }
+
+    memcpy(&length, buf + 3, sizeof(uint32_t));
+    length = BF_NTOHL(length);
+    strategy = loadStrategy((int8_t)*(buf + 1), *(buf + 2), length);
+    if (NULL == strategy) {
+        return NULL;
+    }
+
+    bitset = allocBitset(length);
+    if (NULL == bitset) {
+        return NULL;
+    }
+
+    bitset->magic = (int8_t)*(buf + 1);
+    bitset->hash_num = *(buf + 2);
+    bitset->length = length;
+    data = (uint64_t *)((uint8_t *)bitset + HEADER_LEN);
+
+    while (offset < buf_len) {
+        uint64_t gap = 0;
+
+        if (!varintGet(buf, buf_len, &offset, &gap) || gap >= (uint64_t)length * 64 - next) {
+            freeBitset(bitset);
+            return NULL;
+        }
+
+        next += gap;
+        *(data + (next >> 6)) |= (uint64_t)1 << (next & 63);
+        next++;
+        bitcount++;
+    }
+
+    bloomFilter = (BloomFilter *)calloc(1, sizeof(BloomFilter));
+    bloomFilter->seed = 0;
+    bloomFilter->bit_count = bitcount;
+    bloomFilter->hash_func = MurmurHash3_x64_128;
+    //readers never follow bitset into longs a replace may free.
+    bloomFilter->header = *bitset;
+    bloomFilter->bitset = &bloomFilter->header;
+    bloomFilter->data = (uint8_t *)bitset + HEADER_LEN;
+    bloomFilter->mode = BF_MODE_OWNED;
+    bloomFilter->strategy = strategy;
+
+    return bloomFilter;
+}
+
+BloomFilter *NewBF(uint64_t expect, double fpp)
+{
+    return NewBFStrategy(expect, fpp, BF_MAGIC_GUAVA);
+}
+
+BloomFilter *NewBlockedBF(uint64_t expect, double fpp)
+{
+    return NewBFStrategy(expect, fpp, BF_MAGIC_BLOCKED);
+}
+
+BloomFilter *NewSplitBlockBF(uint64_t expect, double fpp)
+{
+    return NewBFStrategy(expect, fpp, BF_MAGIC_SPLIT_BLOCK);
+}
+
+//longs and hash number of a magic's filter for expect keys. 0->fail.
+int optimalLength(uint64_t expect, double fpp, int8_t magic, int *hash_num_out)
+{
+    uint64_t bit_size                   = 0;
+    int hash_num                        = 0;
+    int length                          = 0;
+
+    //built from its keys, see BuildFuseBF.
+    if (magic == BF_MAGIC_FUSE) {
+        return 0;
+    }
+
+    //as guava, and OptimalNumOfHash divides by it.
+    if (expect == 0) {
+        expect = 1;
+    }
+
+    if (magic == BF_MAGIC_BLOCKED) {
+        bit_size = optimalBlockedBits(expect, fpp, &hash_num);
+    } else if (magic == BF_MAGIC_SPLIT_BLOCK) {
+        bit_size = optimalSplitBlockBits(expect, fpp);
+        hash_num = 8;
+    } else {
+        bit_size = OptimalNumOfBits(expect, fpp);
+        hash_num = OptimalNumOfHash(expect, bit_size);
+    }
+
+    if (magic == BF_MAGIC_POW2) {
+        uint64_t pow2 = 64;
+
+        while (pow2 < bit_size) {
+            pow2 <<= 1;
+        }
+        bit_size = pow2;
+        hash_num = OptimalNumOfHash(expect, bit_size);
+    }
+
+    if (bit_size == 0 || bit_size > BF_MAX_GROW_BITS) {
+        return 0;
+    }
+
+    length = (int)(ceil((double)bit_size / 64.0));
+    if (length <= 0) {
+        return 0;
+    }
+
+    *hash_num_out = hash_num;
+
+    return length;
+}
+
+BloomFilter *NewBFStrategy(uint64_t expect, double fpp, int8_t magic)
+{
+    const struct BFStrategy *strategy   = NULL;
+    BloomFilter *bloomFilter            = NULL;
+    BitSetHeader *bitset                = NULL;
+    int hash_num                        = 0;
+    int length                          = 0;
+
+    if (NULL == findStrategy(magic, 0)) {
+        return NULL;
+    }
+
+    length = optimalLength(expect, fpp, magic, &hash_num);
+    if (length <= 0) {
+        return NULL;
+    }
+
+    bitset = allocBitset(length);
+    if (NULL == bitset) {
+        return NULL;
+    }
+
+    bitset->magic = magic;
+    bitset->hash_num = hash_num;
+    bitset->length = length;
+    strategy = findStrategy(magic, bitset->hash_num);
+
+    bloomFilter = (BloomFilter *)calloc(1, sizeof(BloomFilter));
+    bloomFilter->seed = 0;
+    bloomFilter->bit_count = 0;
+    bloomFilter->hash_func = MurmurHash3_x64_128;
+    //readers never follow bitset into longs a replace may free.
+    bloomFilter->header = *bitset;
+    bloomFilter->bitset = &bloomFilter->header;
+    bloomFilter->data = (uint8_t *)bitset + HEADER_LEN;
+    bloomFilter->mode = BF_MODE_OWNED;
+    bloomFilter->strategy = strategy;
+
+    return bloomFilter;
+}
+
+BloomFilter *LoadBF(void *byte_array, double array_len)
+{
+    BitSetHeader *src_bitset= (BitSetHeader *)(int8_t *)byte_array;
+    uint32_t length         = 0;
+    uint64_t bitcount       = 0;
+    BloomFilter *bloomFilter= NULL;
+    BitSetHeader *bitset    = NULL;
+    uint64_t *src_data      = NULL;
+    uint64_t *dst_data      = NULL;
+    const struct BFStrategy *strategy = NULL;
+
+    if (NULL == byte_array || !(array_len >= HEADER_LEN)) {
+        return NULL;
+    }
+
+    if (src_bitset->magic == BF_SPARSE_MAGIC) {
+        return loadSparse((const uint8_t *)byte_array, (size_t)array_len);
+    }
+
+    length = BF_HTONL(src_bitset->length);
+    strategy = loadStrategy(src_bitset->magic, src_bitset->hash_num, length);
+    if (NULL == strategy || (size_t)array_len < HEADER_LEN + (size_t)length * sizeof(uint64_t)) {
+        return NULL;
+    }
+
+    bitset = allocBitset(length);
+    if (NULL == bitset) {
+        return NULL;
+    }
+
+    bitset->magic = src_bitset->magic;
+    bitset->hash_num = src_bitset->hash_num;
+    bitset->length = length;
+
+    dst_data = (uint64_t *)((void *)bitset + HEADER_LEN);
+    src_data = (uint64_t *)((uint8_t *)byte_array + HEADER_LEN);
+
+    bitcount = findSwapCount()(dst_data, src_data, length);
+
+    bloomFilter = (BloomFilter *)calloc(1, sizeof(BloomFilter));
+    bloomFilter->seed = 0;
+    bloomFilter->bit_count = bitcount;
+    bloomFilter->hash_func = MurmurHash3_x64_128;
+    //readers never follow bitset into longs a replace may free.
+    bloomFilter->header = *bitset;
+    bloomFilter->bitset = &bloomFilter->header;
+    bloomFilter->data = (uint8_t *)bitset + HEADER_LEN;
+    bloomFilter->mode = BF_MODE_OWNED;
+    bloomFilter->strategy = strategy;
+
+    return bloomFilter;
+}
+
+BloomFilter *ViewBF(const void *byte_array, size_t array_len)
+{
+    const BitSetHeader *src_bitset  = (const BitSetHeader *)byte_array;
+    uint32_t length                 = 0;
+    BloomFilter *bloomFilter        = NULL;
+    const struct BFStrategy *strategy = NULL;
+
+    if (NULL == byte_array || array_len < HEADER_LEN) {
+        return NULL;
+    }
+
+    length = BF_NTOHL(src_bitset->length);
+    if (length == 0 || array_len < HEADER_LEN + (size_t)length * sizeof(uint64_t)) {
+        return NULL;
+    }
+
+    strategy = loadStrategy(src_bitset->magic, src_bitset->hash_num, length);
+    if (NULL == strategy) {
+        return NULL;
+    }
+
+    bloomFilter = (BloomFilter *)calloc(1, sizeof(BloomFilter));
+    bloomFilter->seed = 0;
+    bloomFilter->bit_count = 0;
+    bloomFilter->hash_func = MurmurHash3_x64_128;
+    bloomFilter->header.magic = src_bitset->magic;
+    bloomFilter->header.hash_num = src_bitset->hash_num;
+    bloomFilter->header.length = length;
+    bloomFilter->bitset = &bloomFilter->header;
+    bloomFilter->data = (uint8_t *)byte_array + HEADER_LEN;
+    bloomFilter->mode = BF_MODE_VIEW;
+    bloomFilter->strategy = strategy;
+
+    return bloomFilter;
+}
+
+BloomFilter *LoadBFFromFile(const char *path)
+{
+    BitSetFileHeader *header    = NULL;
+    BloomFilter *bloomFilter    = NULL;
+    const struct BFStrategy *strategy = NULL;
+    struct stat st;
+    uint64_t lanes[4]           = {0};
+    uint8_t *map                = NULL;
+    size_t map_len              = 0;
+    int fd                      = -1;
+
+    if (NULL == path) {
+        return NULL;
+    }
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(BitSetFileHeader)) {
+        close(fd);
+        return NULL;
+    }
+
+    map_len = (size_t)st.st_size;
+    map = (uint8_t *)mmap(NULL, map_len, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return NULL;
+    }
+
+    header = (BitSetFileHeader *)map;
+    if (header->magic != BF_FILE_MAGIC
+            || header->version != BF_FILE_VERSION
+            || header->byte_order != BF_FILE_BYTE_ORDER
+            || header->data_offset != BF_FILE_DATA_OFFSET
+            || header->length == 0
+            || map_len != BF_FILE_DATA_OFFSET + (size_t)header->length * sizeof(uint64_t)) {
+        munmap(map, map_len);
+        return NULL;
+    }
+
+    strategy = loadStrategy(header->strategy, header->hash_num, header->length);
+    if (NULL == strategy) {
+        munmap(map, map_len);
+        return NULL;
+    }
+
+    checksumUpdate(lanes, 0, (const uint64_t *)(map + BF_FILE_DATA_OFFSET), header->length);
+    if (checksumFinal(lanes, header->length) != header->checksum) {
+        munmap(map, map_len);
+        return NULL;
+    }
+
+    //probes are random, readahead only wastes the page cache.
+    madvise(map, map_len, MADV_RANDOM);
+
+    bloomFilter = (BloomFilter *)calloc(1, sizeof(BloomFilter));
+    bloomFilter->seed = header->seed;
+    bloomFilter->bit_count = header->bit_count;
+    bloomFilter->hash_func = MurmurHash3_x64_128;
+    bloomFilter->header.magic = header->strategy;
+    bloomFilter->header.hash_num = header->hash_num;
+    bloomFilter->header.length = header->length;
+    bloomFilter->bitset = &bloomFilter->header;
+    bloomFilter->data = map + BF_FILE_DATA_OFFSET;
+    bloomFilter->mode = BF_MODE_MAPPED;
+    bloomFilter->strategy = strategy;
+
+    return bloomFilter;
+}
+
+//temp files of one process, apart even when threads write one path.
+static uint64_t writeSeq = 0;
+
+int WriteBFFile(BloomFilter *bf, const char *path)
+{
+    BitSetFileHeader header;
+    uint64_t buf[BF_FILE_CHUNK];
+    uint64_t lanes[4]           = {0};
+    uint64_t *readers           = NULL;
+    const uint8_t *data         = NULL;
+    uint64_t length             = 0;
+    char *tmp_path              = NULL;
+    size_t path_len             = 0;
+    FILE *fp                    = NULL;
+    int fd                      = -1;
+    int ok                      = 0;
+
+    if (NULL == bf || NULL == bf->bitset || NULL == path) {
+        return 0;
+    }
+
+    length = bf->bitset->length;
+
+    memset(&header, 0, sizeof(BitSetFileHeader));
+    header.magic = BF_FILE_MAGIC;
+    header.version = BF_FILE_VERSION;
+    header.strategy = bf->bitset->magic;
+    header.hash_num = bf->bitset->hash_num;
+    header.byte_order = BF_FILE_BYTE_ORDER;
+    header.length = (uint32_t)length;
+    header.seed = bf->seed;
+    header.bit_count = BitCountBF(bf);
+    header.data_offset = BF_FILE_DATA_OFFSET;
+
+    path_len = strlen(path) + 48;
+    tmp_path = (char *)malloc(path_len);
+    if (NULL == tmp_path) {
+        return 0;
+    }
+    snprintf(tmp_path, path_len, "%s.%d.%llu.tmp", path, (int)getpid(),
+             (unsigned long long)__atomic_fetch_add(&writeSeq, 1, __ATOMIC_RELAXED));
+
+    //O_EXCL, never write into a temp file someone else holds.
+    fd = open(tmp_path, O_WRONLY | O_CREAT | O_EXCL, 0666);
+    if (fd < 0) {
+        free(tmp_path);
+        return 0;
+    }
+
+    fp = fdopen(fd, "wb");
+    if (NULL == fp) {
+        close(fd);
+        unlink(tmp_path);
+        free(tmp_path);
+        return 0;
+    }
+
+    //the checksum is patched in once the longs are written.
+    if (fwrite(&header, sizeof(BitSetFileHeader), 1, fp) != 1) {
+        goto done;
+    }
+
+    //a replace waits for the whole file, it never mixes two bitsets.
+    readers = readEnter(bf);
+    data = readData(bf);
+    for (uint64_t i = 0; i < length; i += BF_FILE_CHUNK) {
+        uint64_t n = length - i < BF_FILE_CHUNK ? length - i : BF_FILE_CHUNK;
+        const uint64_t *words = hostWords(bf, data, i, n, buf);
+
+        checksumUpdate(lanes, i, words, n);
+        if (fwrite(words, sizeof(uint64_t), n, fp) != n) {
+            goto done;
+        }
+    }
+
+    readExit(readers);
+    readers = NULL;
+
+    header.checksum = checksumFinal(lanes, length);
+    if (fseek(fp, 0, SEEK_SET) != 0
+            || fwrite(&header, sizeof(BitSetFileHeader), 1, fp) != 1
+            || fflush(fp) != 0
+            || fsync(fileno(fp)) != 0) {
+        goto done;
+    }
+
+    ok = 1;
+
+done:
+    readExit(readers);
+    if (fclose(fp) != 0) {
+        ok = 0;
+    }
+
+    if (ok && rename(tmp_path, path) != 0) {
+        ok = 0;
+    }
+
+    if (!ok) {
+        unlink(tmp_path);
+    }
+
+    free(tmp_path);
+
+    return ok;
+}
+
+int SetConcurrentBF(BloomFilter *bf, int concurrent)
+{
+    if (NULL == bf || bf->mode != BF_MODE_OWNED) {
+        return 0;
+    }
+
+    if (concurrent) {
+        if (NULL == bf->counters) {
+            size_t size = sizeof(uint64_t) * BF_COUNTER_STRIPES * BF_COUNTER_STRIDE;
+
+            if (posix_memalign((void **)&bf->counters, BF_DATA_ALIGN, size) != 0) {
+                bf->counters = NULL;
+                return 0;
+            }
+            memset(bf->counters, 0, size);
+        }
+
+        pthread_once(&counterStripeOnce, counterStripeAtFork);
+
+        bf->concurrent = 1;
+
+        return 1;
+    }
+
+    //writers are quiesced, fold the stripes back.
+    bf->bit_count = BitCountBF(bf);
+    if (NULL != bf->counters) {
+        memset(bf->counters, 0, sizeof(uint64_t) * BF_COUNTER_STRIPES * BF_COUNTER_STRIDE);
+    }
+    bf->concurrent = 0;
+
+    return 1;
+}
+
+uint64_t BitCountBF(BloomFilter *bf)
+{
+    uint64_t bit_count = 0;
+
+    if (NULL == bf) {
+        return 0;
+    }
+
+    bit_count = __atomic_load_n(&bf->bit_count, __ATOMIC_RELAXED);
+    if (NULL != bf->counters) {
+        for (int i = 0; i < BF_COUNTER_STRIPES; i++) {
+            bit_count += __atomic_load_n(bf->counters + i * BF_COUNTER_STRIDE, __ATOMIC_RELAXED);
+        }
+    }
+
+    return bit_count;
+}
+
+//a filter over a shared mapping of map_len, which it then owns.
+static BloomFilter *sharedBF(uint8_t *map, size_t map_len)
+{
+    BitSetFileHeader *header    = (BitSetFileHeader *)map;
+    BloomFilter *bloomFilter    = NULL;
+    const struct BFStrategy *strategy = NULL;
+
+    if (NULL == map || map_len < BF_SHARED_DATA_OFFSET) {
+        return NULL;
+    }
+
+    if (header->magic != BF_FILE_MAGIC
+            || header->version != BF_FILE_VERSION
+            || header->byte_order != BF_FILE_BYTE_ORDER
+            || header->data_offset != BF_SHARED_DATA_OFFSET
+            || header->length == 0
+            || map_len != BF_SHARED_DATA_OFFSET + (size_t)header->length * sizeof(uint64_t)) {
+        return NULL;
+    }
+
+    strategy = loadStrategy(header->strategy, header->hash_num, header->length);
+    if (NULL == strategy) {
+        return NULL;
+    }
+
+    pthread_once(&counterStripeOnce, counterStripeAtFork);
+
+    bloomFilter = (BloomFilter *)calloc(1, sizeof(BloomFilter));
+    bloomFilter->seed = header->seed;
+    bloomFilter->hash_func = MurmurHash3_x64_128;
+    bloomFilter->header.magic = header->strategy;
+    bloomFilter->header.hash_num = header->hash_num;
+    bloomFilter->header.length = header->length;
+    bloomFilter->bitset = &bloomFilter->header;
+    bloomFilter->data = map + BF_SHARED_DATA_OFFSET;
+    bloomFilter->mode = BF_MODE_SHARED;
+    bloomFilter->strategy = strategy;
+    //every process counts into the stripes of the mapping.
+    bloomFilter->concurrent = 1;
+    bloomFilter->counters = (uint64_t *)(map + BF_FILE_DATA_OFFSET);
+
+    return bloomFilter;
+}
+
+BloomFilter *NewSharedBF(uint64_t expect, double fpp, int8_t magic, int fd)
+{
+    BitSetFileHeader *header    = NULL;
+    BloomFilter *bloomFilter    = NULL;
+    struct stat st;
+    uint8_t *map                = NULL;
+    size_t map_len              = 0;
+    int hash_num                = 0;
+    int length                  = 0;
+
+    if (NULL == findStrategy(magic, 0)) {
+        return NULL;
+    }
+
+    length = optimalLength(expect, fpp, magic, &hash_num);
+    if (length <= 0) {
+        return NULL;
+    }
+
+    map_len = BF_SHARED_DATA_OFFSET + (size_t)length * sizeof(uint64_t);
+    if (fd < 0) {
+        map = (uint8_t *)mmap(NULL, map_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    } else {
+        //only an empty file maps as zero, stale bits would be false positives.
+        if (fstat(fd, &st) != 0 || st.st_size != 0) {
+            return NULL;
+        }
+        if (ftruncate(fd, (off_t)map_len) != 0) {
+            return NULL;
+        }
+        map = (uint8_t *)mmap(NULL, map_len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    if (map == MAP_FAILED) {
+        return NULL;
+    }
+
+    //anonymous or grown from empty, the stripes and longs start cleared.
+    header = (BitSetFileHeader *)map;
+    header->magic = BF_FILE_MAGIC;
+    header->version = BF_FILE_VERSION;
+    header->strategy = magic;
+    header->hash_num = (uint8_t)hash_num;
+    header->byte_order = BF_FILE_BYTE_ORDER;
+    header->length = (uint32_t)length;
+    header->seed = 0;
+    header->data_offset = BF_SHARED_DATA_OFFSET;
+
+    bloomFilter = sharedBF(map, map_len);
+    if (NULL == bloomFilter) {
+        munmap(map, map_len);
+    }
+
+    return bloomFilter;
+}
+
+BloomFilter *AttachSharedBF(int fd)
+{
+    BloomFilter *bloomFilter    = NULL;
+    struct stat st;
+    uint8_t *map                = NULL;
+    size_t map_len              = 0;
+
+    if (fd < 0 || fstat(fd, &st) != 0 || (size_t)st.st_size < BF_SHARED_DATA_OFFSET) {
+        return NULL;
+    }
+
+    map_len = (size_t)st.st_size;
+    map = (uint8_t *)mmap(NULL, map_len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        return NULL;
+    }
+
+    bloomFilter = sharedBF(map, map_len);
+    if (NULL == bloomFilter) {
+        munmap(map, map_len);
+    }
+
+    return bloomFilter;
+}
+
+/*
+ * Delta sync. A filter with a dirty bitmap marks the BF_DIRTY_WORDS line of
+ * every long a put changes, and in a second bitmap the lines that lost
+ * bits, to a replace or an intersect, or all at once when tracking starts.
+ * SerializeDelta emits the dirty lines, runs of them with the same op
+ * merged into ranges, and clears their marks:
+ *  [int8 BF_DELTA_MAGIC][int8 magic][uint8 hash_num][uint8 0]
+ *  [uint32 BE length][uint32 BE ranges]
+ *  ranges * ([uint8 op][uint32 BE first long][uint32 BE longs]
+ *            [longs BE uint64 longs])
+ * ApplyDelta ORs the longs of a BF_DELTA_OR range into a filter of the same
+ * geometry, and stores those of a BF_DELTA_OVERWRITE range over its own.
+ */
+
+int EnableDirtyBF(BloomFilter *bf)
+{
+    size_t size = 0;
+
+    if (NULL == bf || bf->mode != BF_MODE_OWNED) {
+        return 0;
+    }
+
+    if (NULL != bf->dirty) {
+        return 1;
+    }
+
+    //the dirty bitmap, then the overwrite one.
+    size = 2 * sizeof(uint64_t) * ((dirtyLines(bf) + 63) / 64);
+    bf->dirty = (uint64_t *)calloc(1, size);
+    if (NULL == bf->dirty) {
+        return 0;
+    }
+
+    //nothing was sent yet, the first delta overwrites the whole filter.
+    dirtyAll(bf);
+
+    return 1;
+}
+
+size_t DeltaSizeBF(BloomFilter *bf)
+{
+    uint64_t lines      = 0;
+    uint64_t dirty      = 0;
+
+    if (NULL == bf || NULL == bf->dirty) {
+        return 0;
+    }
+
+    lines = dirtyLines(bf);
+    for (uint64_t i = 0; i < (lines + 63) / 64; i++) {
+        dirty += __builtin_popcountll(__atomic_load_n(bf->dirty + i, __ATOMIC_RELAXED));
+    }
+
+    //worst case every line is a range of its own.
+    return BF_DELTA_HEADER_LEN + dirty * (BF_DELTA_RANGE_LEN + BF_DIRTY_WORDS * sizeof(uint64_t));
+}
+
+BF_ALWAYS_INLINE int dirtyTest(const uint64_t *bitmap, uint64_t line)
+{
+    return (__atomic_load_n(bitmap + (line >> 6), __ATOMIC_ACQUIRE) >> (line & 63)) & 1;
+}
+
+size_t SerializeDelta(BloomFilter *bf, uint8_t *buf, size_t buf_len)
+{
+    uint64_t *readers           = NULL;
+    uint64_t *overwrite         = NULL;
+    const uint8_t *data         = NULL;
+    uint64_t lines              = 0;
+    uint32_t length             = 0;
+    uint32_t ranges             = 0;
+    uint32_t be_value           = 0;
+    size_t offset               = BF_DELTA_HEADER_LEN;
+    uint64_t line               = 0;
+
+    if (NULL == bf || NULL == bf->dirty || NULL == buf || buf_len < BF_DELTA_HEADER_LEN) {
+        return 0;
+    }
+
+    length = bf->bitset->length;
+    lines = dirtyLines(bf);
+    overwrite = dirtyOverwrite(bf);
+
+    readers = readEnter(bf);
+    data = readData(bf);
+
+    while (line < lines) {
+        uint64_t end    = 0;
+        uint64_t first  = 0;
+        uint64_t count  = 0;
+        size_t bytes    = 0;
+        uint8_t op      = BF_DELTA_OR;
+
+        if (__atomic_load_n(bf->dirty + (line >> 6), __ATOMIC_RELAXED) >> (line & 63) == 0) {
+            line = (line | 63) + 1;
+            continue;
+        }
+
+        if (!dirtyTest(bf->dirty, line)) {
+            line++;
+            continue;
+        }
+
+        op = dirtyTest(overwrite, line) ? BF_DELTA_OVERWRITE : BF_DELTA_OR;
+        for (end = line + 1; end < lines && dirtyTest(bf->dirty, end) && dirtyTest(overwrite, end) == op; end++);
+
+        //a run longer than what is left of buf is cut to whole lines, the
+        //rest stays dirty for the next delta.
+        if (offset + BF_DELTA_RANGE_LEN < buf_len) {
+            uint64_t fit = (buf_len - offset - BF_DELTA_RANGE_LEN) / (BF_DIRTY_WORDS * sizeof(uint64_t));
+
+            end = end - line > fit ? line + fit : end;
+        }
+
+        first = line * BF_DIRTY_WORDS;
+        count = (end * BF_DIRTY_WORDS < length ? end * BF_DIRTY_WORDS : length) - first;
+        bytes = BF_DELTA_RANGE_LEN + count * sizeof(uint64_t);
+
+        if (end == line || offset + bytes > buf_len) {
+            break;
+        }
+
+        //clear before copying, a put in between marks its line again. The
+        //overwrite marks go after the dirty ones: one set since the run was
+        //picked turns the whole run into an overwrite, none is lost.
+        for (uint64_t i = line; i < end; i++) {
+            __atomic_fetch_and(bf->dirty + (i >> 6), ~((uint64_t)1 << (i & 63)), __ATOMIC_RELAXED);
+        }
+        for (uint64_t i = line; i < end; i++) {
+            uint64_t mask = (uint64_t)1 << (i & 63);
+
+            if (__atomic_fetch_and(overwrite + (i >> 6), ~mask, __ATOMIC_RELAXED) & mask) {
+                op = BF_DELTA_OVERWRITE;
+            }
+        }
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+        *(buf + offset) = op;
+        be_value = BF_HTONL((uint32_t)first);
+        memcpy(buf + offset + 1, &be_value, sizeof(uint32_t));
+        be_value = BF_HTONL((uint32_t)count);
+        memcpy(buf + offset + 5, &be_value, sizeof(uint32_t));
+        findSwapCount()(buf + offset + BF_DELTA_RANGE_LEN, (const uint64_t *)data + first, count);
+
+        offset += bytes;
+        ranges++;
+        line = end;
+    }
+
+    readExit(readers);
+
+    *buf = BF_DELTA_MAGIC;
+    *(buf + 1) = bf->bitset->magic;
+    *(buf + 2) = bf->bitset->hash_num;
+    *(buf + 3) = 0;
+    be_value = BF_HTONL(length);
+    memcpy(buf + 4, &be_value, sizeof(uint32_t));
+    be_value = BF_HTONL(ranges);
+    memcpy(buf + 8, &be_value, sizeof(uint32_t));
+
+    return offset;
+}
+
+int ApplyDelta(BloomFilter *bf, const uint8_t *buf, size_t buf_len)
+{
+    uint64_t *readers           = NULL;
+    uint8_t *data               = NULL;
+    uint32_t ranges             = 0;
+    uint32_t be_value           = 0;
+    size_t offset               = BF_DELTA_HEADER_LEN;
+
+    if (NULL == bf || NULL == bf->bitset || !writable(bf)) {
+        return 0;
+    }
+
+    if (NULL == buf || buf_len < BF_DELTA_HEADER_LEN) {
+        return 0;
+    }
+
+    memcpy(&be_value, buf + 4, sizeof(uint32_t));
+    if ((int8_t)*buf != BF_DELTA_MAGIC
+            || (int8_t)*(buf + 1) != bf->bitset->magic
+            || *(buf + 2) != bf->bitset->hash_num
+            || BF_NTOHL(be_value) != bf->bitset->length
+            || NULL == loadStrategy(bf->bitset->magic, bf->bitset->hash_num, bf->bitset->length)) {
+        return 0;
+    }
+
+    memcpy(&be_value, buf + 8, sizeof(uint32_t));
+    ranges = BF_NTOHL(be_value);
+
+    //check every range before touching the filter.
+    for (uint32_t r = 0; r < ranges; r++) {
+        uint64_t first  = 0;
+        uint64_t count  = 0;
+
+        if (offset + BF_DELTA_RANGE_LEN > buf_len) {
+            return 0;
+        }
+
+        memcpy(&be_value, buf + offset + 1, sizeof(uint32_t));
+        first = BF_NTOHL(be_value);
+        memcpy(&be_value, buf + offset + 5, sizeof(uint32_t));
+        count = BF_NTOHL(be_value);
+
+        if (*(buf + offset) > BF_DELTA_OVERWRITE || first + count > bf->bitset->length || buf_len - offset - BF_DELTA_RANGE_LEN < count * sizeof(uint64_t)) {
+            return 0;
+        }
+
+        offset += BF_DELTA_RANGE_LEN + count * sizeof(uint64_t);
+    }
+
+    offset = BF_DELTA_HEADER_LEN;
+    readers = readEnter(bf);
+    data = readData(bf);
+
+    for (uint32_t r = 0; r < ranges; r++) {
+        uint64_t *words = NULL;
+        uint64_t count  = 0;
+        uint8_t op      = *(buf + offset);
+
+        memcpy(&be_value, buf + offset + 1, sizeof(uint32_t));
+        words = (uint64_t *)data + BF_NTOHL(be_value);
+        memcpy(&be_value, buf + offset + 5, sizeof(uint32_t));
+        count = BF_NTOHL(be_value);
+        offset += BF_DELTA_RANGE_LEN;
+
+        for (uint64_t i = 0; i < count; i++) {
+            uint64_t word = 0;
+
+            memcpy(&word, buf + offset + i * sizeof(uint64_t), sizeof(uint64_t));
+            word = BF_NTOHLL(word);
+            if (op == BF_DELTA_OVERWRITE) {
+                WordsStore(bf, data, words + i, word);
+            } else if (word != 0) {
+                WordsSet(bf, data, words + i, word);
+            }
+        }
+
+        offset += count * sizeof(uint64_t);
+    }
+
+    readExit(readers);
+
+    return 1;
+}
+
+//one replace at a time, readers never take it.
+static pthread_mutex_t replaceLock = PTHREAD_MUTEX_INITIALIZER;
+
+int ReplaceBitsetBF(BloomFilter *bf, BloomFilter *src)
+{
+    uint8_t *old                = NULL;
+    uint64_t bit_count          = 0;
+    uint64_t epoch              = 0;
+
+    if (NULL == bf || NULL == src || bf == src) {
+        return 0;
+    }
+
+    if (bf->mode != BF_MODE_OWNED || src->mode != BF_MODE_OWNED) {
+        return 0;
+    }
+
+    //readers load the header and the longs apart, they must agree.
+    if (bf->bitset->magic != src->bitset->magic
+            || bf->bitset->hash_num != src->bitset->hash_num
+            || bf->bitset->length != src->bitset->length) {
+        return 0;
+    }
+
+    bit_count = BitCountBF(src);
+
+    pthread_mutex_lock(&replaceLock);
+
+    //the count restarts before the longs are published, so no put on the
+    //new longs counts into stripes cleared after it. Only puts still in
+    //flight on the old longs add to the new count, until the drain.
+    if (bf->concurrent) {
+        for (int i = 0; i < BF_COUNTER_STRIPES; i++) {
+            __atomic_store_n(bf->counters + i * BF_COUNTER_STRIDE, 0, __ATOMIC_RELAXED);
+        }
+    }
+    __atomic_store_n(&bf->bit_count, bit_count, __ATOMIC_RELAXED);
+
+    //same header, only the longs change hands.
+    old = bf->data;
+    __atomic_store_n(&bf->data, src->data, __ATOMIC_SEQ_CST);
+
+    if (bf->concurrent) {
+        //readers entered from now on see the new longs, drain the others.
+        epoch = __atomic_fetch_add(&bf->epoch, 1, __ATOMIC_SEQ_CST);
+
+        for (;;) {
+            uint64_t readers = 0;
+
+            for (int i = 0; i < BF_COUNTER_STRIPES; i++) {
+                readers += __atomic_load_n(bf->counters + i * BF_COUNTER_STRIDE + 1 + (epoch & 1),
+                                           __ATOMIC_ACQUIRE);
+            }
+
+            if (readers == 0) {
+                break;
+            }
+
+            sched_yield();
+        }
+    }
+
+    //every long may differ and lose bits, the next delta overwrites them
+    //all on the replicas. After the drain: a delta still on the old longs
+    //would clear the marks of the new ones.
+    if (NULL != bf->dirty) {
+        dirtyAll(bf);
+    }
+
+    pthread_mutex_unlock(&replaceLock);
+
+    freeBitset((BitSetHeader *)(old - HEADER_LEN));
+
+    src->bitset = NULL;
+    DestroyBF(src);
+
+    return 1;
+}
+
+//same probes over the same longs, so bits line up. A fuse filter has none.
+static int compatible(const BloomFilter *a, const BloomFilter *b)
+{
+    return NULL != a && NULL != b && NULL != a->bitset && NULL != b->bitset
+        && a->bitset->magic == b->bitset->magic
+        && a->bitset->hash_num == b->bitset->hash_num
+        && a->bitset->length == b->bitset->length
+        && a->seed == b->seed
+        && a->bitset->magic != BF_MAGIC_FUSE;
+}
+
+//Swamidass-Baldi, the keys behind bits_set of bit_size bits.
+static double estimateKeys(uint64_t bits_set, uint64_t bit_size, int hash_num)
+{
+    if (bits_set >= bit_size) {
+        return INFINITY;
+    }
+
+    return -((double)bit_size / hash_num) * log1p(-(double)bits_set / (double)bit_size);
+}
+
+//an intersect clears bits, its lines go to the replicas as overwrites.
+BF_ALWAYS_INLINE void dirtyMerged(BloomFilter *bf, const uint8_t *data, const uint64_t *word, int intersect)
+{
+    if (intersect) {
+        dirtyMarkCleared(bf, data, word);
+    } else {
+        dirtyMark(bf, data, word);
+    }
+}
+
+static int mergeBF(BloomFilter *dst, BloomFilter *src, int intersect)
+{
+    uint64_t *dst_readers   = NULL;
+    uint64_t *src_readers   = NULL;
+    uint8_t *dst_data       = NULL;
+    const uint8_t *src_data = NULL;
+    uint64_t word_buf[BF_FILE_CHUNK];
+    MergeFunc merge         = findMerge(intersect);
+    uint64_t length         = 0;
+    uint64_t flipped        = 0;
+
+    if (!compatible(dst, src) || !writable(dst)) {
+        return 0;
+    }
+
+    if (dst == src) {
+        return 1;
+    }
+
+    length = dst->bitset->length;
+
+    dst_readers = readEnter(dst);
+    src_readers = readEnter(src);
+    dst_data = readData(dst);
+    src_data = readData(src);
+
+    for (uint64_t i = 0; i < length; i += BF_FILE_CHUNK) {
+        uint64_t n = length - i < BF_FILE_CHUNK ? length - i : BF_FILE_CHUNK;
+        const uint64_t *words = hostWords(src, src_data, i, n, word_buf);
+        uint64_t *data = (uint64_t *)dst_data + i;
+
+        //other threads may put, a word at a time keeps their bits.
+        if (dst->concurrent) {
+            for (uint64_t j = 0; j < n; j++) {
+                uint64_t old = intersect ? __atomic_fetch_and(data + j, *(words + j), __ATOMIC_RELAXED)
+                                         : __atomic_fetch_or(data + j, *(words + j), __ATOMIC_RELAXED);
+                uint64_t changed = intersect ? old & ~*(words + j) : ~old & *(words + j);
+
+                if (changed) {
+                    flipped += __builtin_popcountll(changed);
+                    if (NULL != dst->dirty) {
+                        dirtyMerged(dst, dst_data, data + j, intersect);
+                    }
+                }
+            }
+            continue;
+        }
+
+        if (NULL == dst->dirty) {
+            flipped += merge(data, words, n);
+            continue;
+        }
+
+        for (uint64_t j = 0; j < n; j += BF_DIRTY_WORDS) {
+            uint64_t line = n - j < BF_DIRTY_WORDS ? n - j : BF_DIRTY_WORDS;
+            uint64_t changed = merge(data + j, words + j, line);
+
+            if (changed) {
+                flipped += changed;
+                dirtyMerged(dst, dst_data, data + j, intersect);
+            }
+        }
+    }
+
+    readExit(src_readers);
+    readExit(dst_readers);
+
+    if (intersect) {
+        flipped = (uint64_t)0 - flipped;
+    }
+
+    if (dst->concurrent) {
+        counterAdd(dst, flipped);
+    } else {
+        dst->bit_count += flipped;
+    }
+
+    return 1;
+}
+
+int UnionBF(BloomFilter *dst, BloomFilter *src)
+{
+    return mergeBF(dst, src, 0);
+}
+
+int IntersectBF(BloomFilter *dst, BloomFilter *src)
+{
+    return mergeBF(dst, src, 1);
+}
+
+double JaccardEstimateBF(BloomFilter *a, BloomFilter *b)
+{
+    uint64_t *a_readers     = NULL;
+    uint64_t *b_readers     = NULL;
+    const uint8_t *a_data   = NULL;
+    const uint8_t *b_data   = NULL;
+    uint64_t a_buf[BF_FILE_CHUNK];
+    uint64_t b_buf[BF_FILE_CHUNK];
+    uint64_t counts[3]      = {0};
+    UnionCountFunc count    = findUnionCount();
+    uint64_t length         = 0;
+    uint64_t bit_size       = 0;
+    int hash_num            = 0;
+    double keys_a           = 0;
+    double keys_b           = 0;
+    double keys_union       = 0;
+    double jaccard          = 0;
+
+    if (!compatible(a, b)) {
+        return -1;
+    }
+
+    length = a->bitset->length;
+    bit_size = length * 64;
+    hash_num = a->bitset->hash_num;
+
+    a_readers = readEnter(a);
+    b_readers = readEnter(b);
+    a_data = readData(a);
+    b_data = readData(b);
+
+    for (uint64_t i = 0; i < length; i += BF_FILE_CHUNK) {
+        uint64_t n = length - i < BF_FILE_CHUNK ? length - i : BF_FILE_CHUNK;
+
+        count(hostWords(a, a_data, i, n, a_buf), hostWords(b, b_data, i, n, b_buf), n, counts);
+    }
+
+    readExit(b_readers);
+    readExit(a_readers);
+
+    //two empty filters hold the same, empty, set.
+    if (counts[2] == 0) {
+        return 1;
+    }
+
+    keys_a = estimateKeys(counts[0], bit_size, hash_num);
+    keys_b = estimateKeys(counts[1], bit_size, hash_num);
+    keys_union = estimateKeys(counts[2], bit_size, hash_num);
+    if (isinf(keys_union)) {
+        return isinf(keys_a) && isinf(keys_b) ? 1 : 0;
+    }
+
+    jaccard = (keys_a + keys_b - keys_union) / keys_union;
+
+    return jaccard < 0 ? 0 : jaccard > 1 ? 1 : jaccard;
+}
+
+//a view keeps no count, its longs are counted as they are.
+static uint64_t bitsSet(BloomFilter *bf)
+{
+    uint64_t *readers   = NULL;
+    const uint8_t *data = NULL;
+    uint64_t word_buf[BF_FILE_CHUNK];
+    uint64_t length     = bf->bitset->length;
+    uint64_t count      = 0;
+
+    if (bf->mode != BF_MODE_VIEW) {
+        return BitCountBF(bf);
+    }
+
+    readers = readEnter(bf);
+    data = readData(bf);
+    for (uint64_t i = 0; i < length; i += BF_FILE_CHUNK) {
+        uint64_t n = length - i < BF_FILE_CHUNK ? length - i : BF_FILE_CHUNK;
+
+        count += findSwapCount()(word_buf, data + i * sizeof(uint64_t), n);
+    }
+    readExit(readers);
+
+    return count;
+}
+
+double EstimateCountBF(BloomFilter *bf)
+{
+    if (NULL == bf || NULL == bf->bitset || bf->bitset->hash_num == 0 || bf->bitset->magic == BF_MAGIC_FUSE) {
+        return -1;
+    }
+
+    return estimateKeys(bitsSet(bf), (uint64_t)bf->bitset->length * 64, bf->bitset->hash_num);
+}
+
+double CurrentFppBF(BloomFilter *bf)
+{
+    if (NULL == bf || NULL == bf->bitset || bf->bitset->hash_num == 0 || bf->bitset->magic == BF_MAGIC_FUSE) {
+        return -1;
+    }
+
+    return pow((double)bitsSet(bf) / ((double)bf->bitset->length * 64), bf->bitset->hash_num);
+}
+
+void DestroyBF(BloomFilter *bf)
+{
+    if(bf != NULL) {
+        if (bf->mode == BF_MODE_OWNED) {
+            free(bf->counters);
+            free(bf->dirty);
+        }
+        if (bf->mode == BF_MODE_MAPPED) {
+            munmap(bf->data - BF_FILE_DATA_OFFSET,
+                    BF_FILE_DATA_OFFSET + (size_t)bf->bitset->length * sizeof(uint64_t));
+        }
+        if (bf->mode == BF_MODE_SHARED) {
+            munmap(bf->data - BF_SHARED_DATA_OFFSET,
+                    BF_SHARED_DATA_OFFSET + (size_t)bf->bitset->length * sizeof(uint64_t));
+        }
+        if (bf->bitset != NULL && bf->mode == BF_MODE_OWNED) {
+            freeBitset((BitSetHeader *)(bf->data - HEADER_LEN));
+        }
+        free(bf);
+    }
+}
+
+//the longs are loaded once per call, see readData.
+BF_ALWAYS_INLINE int strategyPut(BloomFilter *bf, uint64_t h1, uint64_t h2)
+{
+    uint64_t *readers   = readEnter(bf);
+    int bits_changed    = bf->strategy->put(bf, readData(bf), h1, h2);
+
+    readExit(readers);
+
+    return bits_changed;
+}
+
+BF_ALWAYS_INLINE int strategyContain(BloomFilter *bf, uint64_t h1, uint64_t h2)
+{
+    uint64_t *readers   = readEnter(bf);
+    int is_in           = bf->strategy->contain(bf, readData(bf), h1, h2);
+
+    readExit(readers);
+
+    return is_in;
+}
+
+//hash_func of the 8 little endian bytes of key, inlined for murmur.
+static inline void hashUint64(BloomFilter *bf, uint64_t key, uint64_t *out)
+{
+    uint8_t bytes[8]    = {0};
+
+    if (bf->hash_func == MurmurHash3_x64_128) {
+        MurmurHash3_x64_128_u64(key, bf->seed, out);
+        return;
+    }
+
+    for (int i = 0; i < 8; i++) {
+        bytes[i] = (uint8_t)(key >> (8 * i));
+    }
+    bf->hash_func(bytes, 8, bf->seed, out);
+}
+
+int PutStrNumber(BloomFilter *bf, StrNumber sn)
+{
+    uint64_t key            = (uint64_t)atoll((const char *)sn.str);
+    uint64_t out[2]         = {0};
+
+    if (NULL == bf) {
+        return 0;
+    }
+
+    if (NULL == bf->hash_func || !writable(bf)) {
+        return 0;
+    }
+
+    hashUint64(bf, key, out);
+
+    return strategyPut(bf, *out, *(out + 1));
+}
+
+int PutUint64(BloomFilter *bf, double sn)
+{
+    uint64_t key            = (uint64_t)sn;
+    uint64_t out[2]         = {0};
+
+    if (NULL == bf) {
+        return 0;
+    }
+
+    if (NULL == bf->hash_func || !writable(bf)) {
+        return 0;
+    }
+
+    hashUint64(bf, key, out);
+
+    return strategyPut(bf, *out, *(out + 1));
+}
+
+int MightContainStrNumber(BloomFilter *bf, StrNumber sn)
+{
+    uint64_t key            = (uint64_t)atoll((const char *)sn.str);
+    uint64_t out[2]         = {0};
+
+    if (NULL == bf) {
+        return 0;
+    }
+
+    if (NULL == bf->bitset) {
+        return 0;
+    }
+
+    if (NULL == bf->hash_func) {
+        return 0;
+    }
+
+    if (bf->bitset->hash_num == 0) {
+        return 0;
+    }
+
+    hashUint64(bf, key, out);
+
+    return strategyContain(bf, *out, *(out + 1));
+}
+
+//atoll of str[0, len) without a NUL: spaces, sign, digits, saturated.
+static uint64_t strNumberKey(const char *str, size_t len)
 {
-    uint64_t c = 0;
+    size_t i            = 0;
+    int negative        = 0;
+    uint64_t limit      = INT64_MAX;
+    uint64_t value      = 0;
+
+    while (i < len && (str[i] == ' ' || (str[i] >= '\t' && str[i] <= '\r'))) {
+        i++;
+    }
+
+    if (i < len && (str[i] == '-' || str[i] == '+')) {
+        negative = str[i] == '-';
+        i++;
+    }
 
-    for (; i != 0; i = i >> 1) {
-        if ((i&1) == 1) {
-            c++;
+    if (negative) {
+        limit = (uint64_t)INT64_MAX + 1;
+    }
+
+    for (; i < len && str[i] >= '0' && str[i] <= '9'; i++) {
+        uint64_t digit = (uint64_t)(str[i] - '0');
+
+        if (value > (limit - digit) / 10) {
+            value = limit;
+            break;
         }
+        value = value * 10 + digit;
+    }
+
+    return negative ? (uint64_t)0 - value : value;
+}
+
+int MightContainStrNumberLen(BloomFilter *bf, const char *str, size_t len)
+{
+    uint64_t out[2]         = {0};
+
+    if (NULL == bf || NULL == bf->bitset || NULL == bf->hash_func || (NULL == str && len > 0)) {
+        return 0;
+    }
+
+    if (bf->bitset->hash_num == 0) {
+        return 0;
     }
 
-    return c;
-}
+    hashUint64(bf, strNumberKey(str, len), out);
 
-int BitsGet(uint64_t *data, uint64_t bit_index)
-{
-    return (data[bit_index >> 6] & ((uint64_t) 1 << (bit_index & 63))) != 0;
+    return strategyContain(bf, *out, *(out + 1));
 }
 
-int BitsSet(BloomFilter *bf, uint64_t bit_index)
+int MightContainNumber(BloomFilter *bf, double sn)
 {
-    uint64_t long_index = 0;
-    uint64_t mask       = 0;
-    uint64_t *data      = (uint64_t *)((void *)bf->bitset + HEADER_LEN);
+    uint64_t key            = (uint64_t)sn;
+    uint64_t out[2]         = {0};
 
-    if (BitsGet(data, bit_index)) {
+    if (NULL == bf) {
         return 0;
     }
 
-    long_index = bit_index >> 6;
-    mask = (uint64_t)1 << (bit_index & 63);
-
-    for (int i = 0; i < bf->bitset->hash_num; i++) {
-        uint64_t old = *(data + long_index);
-        uint64_t new = old | mask;
+    if (NULL == bf->bitset) {
+        return 0;
+    }
 
-        if (old == new) {
-            return 0;
-        }
+    if (NULL == bf->hash_func) {
+        return 0;
+    }
 
-        //TODO:automic
-        if (__sync_bool_compare_and_swap(data + long_index, old, new) == 1) {
-            break;
-        }
+    if (bf->bitset->hash_num == 0) {
+        return 0;
     }
 
-    //TOOD:atomic
-    bf->bit_count ++;
+    hashUint64(bf, key, out);
 
-    return 1;
+    return strategyContain(bf, *out, *(out + 1));
 }
 
-uint64_t OptimalNumOfBits(uint64_t n, double p)
+int PutBytes(BloomFilter *bf, const void *key, size_t len)
 {
-    if (p == 0) {
-        p = 4.940656458412465441765687928682213723651e-324;
+    uint64_t out[2]         = {0};
+
+    if (NULL == bf || NULL == bf->hash_func || !writable(bf)) {
+        return 0;
     }
 
-    return (uint64_t)(-1 * (double)n * log(p) / (log(2) * log(2)));
-}
+    if ((NULL == key && len > 0) || len > INT32_MAX) {
+        return 0;
+    }
 
-//TODO:check
-int OptimalNumOfHash(uint64_t n, uint64_t m)
-{
-    return (int)(fmax(1, floor(((double)(m / n) * log(2)) + 0.5)));
+    bf->hash_func(key, (int)len, bf->seed, out);
+
+    return strategyPut(bf, *out, *(out + 1));
 }
 
-uint8_t * Serialized(BloomFilter *bf)
+int MightContainBytes(BloomFilter *bf, const void *key, size_t len)
 {
-    int8_t magic                = 0;
-    uint8_t hash_num            = 0;
-    uint32_t length             = 0;
-    uint8_t *buf                = (uint8_t *)bf->bitset;
-    uint64_t *data              = NULL;
-    int words                   = sizeof(uint64_t);
+    uint64_t out[2]         = {0};
 
-    if (bf == NULL) {
-        return NULL;
+    if (NULL == bf || NULL == bf->bitset || NULL == bf->hash_func) {
+        return 0;
     }
 
-    data = (uint64_t *)((void *)bf->bitset + HEADER_LEN);
-    magic = bf->bitset->magic;
-    hash_num = bf->bitset->hash_num;
-    length = bf->bitset->length;
-
-    *buf = magic;
-    *(buf + 1) = hash_num;
-    BF_HTONL_ARRAY((buf + 2), length);
-
-    for (int i = 0; i < length; i++) {
-        uint64_t number = *(data + i);
-        BF_HTONLL_ARRAY((buf + HEADER_LEN + i * words), number);
+    if (bf->bitset->hash_num == 0 || (NULL == key && len > 0) || len > INT32_MAX) {
+        return 0;
     }
 
-    buf = NULL;
-    data = NULL;
+    bf->hash_func(key, (int)len, bf->seed, out);
 
-    return (uint8_t *)bf->bitset;
+    return strategyContain(bf, *out, *(out + 1));
 }
 
-BloomFilter *NewBF(uint64_t expect, double fpp)
+//guava integerFunnel, putInt: the 4 little endian bytes.
+static inline void int32Bytes(int32_t sn, uint8_t *bytes)
 {
-    BloomFilter *bloomFilter    = NULL;
-    BitSetHeader *bitset        = NULL;
-    uint64_t bit_size           = 0;
-    int length                  = 0;
-
-
-    bit_size = OptimalNumOfBits(expect, fpp);
+    uint32_t value = (uint32_t)sn;
 
-    length = (int)(ceil((double)bit_size / 64.0));
-    if (length <= 0) {
-        return NULL;
+    for (int i = 0; i < 4; i++) {
+        *(bytes + i) = (uint8_t)(value >> (i * 8));
     }
+}
 
-    bitset = (BitSetHeader *)malloc(sizeof(uint64_t) * length + HEADER_LEN);
-    memset(bitset, 0, sizeof(uint64_t) * length + HEADER_LEN);
-
-    bitset->magic = 1;
-    bitset->hash_num = OptimalNumOfHash(expect, bit_size);
-    bitset->length = length;
+int PutInt32(BloomFilter *bf, int32_t sn)
+{
+    uint8_t bytes[4];
 
-    bloomFilter = (BloomFilter *)malloc(sizeof(BloomFilter));
-    bloomFilter->seed = 0;
-    bloomFilter->bit_count = 0;
-    bloomFilter->hash_func = MurmurHash3_x64_128;
-    bloomFilter->bitset = bitset;
+    int32Bytes(sn, bytes);
 
-    return bloomFilter;
+    return PutBytes(bf, bytes, sizeof(bytes));
 }
 
-BloomFilter *LoadBF(void *byte_array, double array_len)
+int MightContainInt32(BloomFilter *bf, int32_t sn)
 {
-    BitSetHeader *src_bitset= (BitSetHeader *)(int8_t *)byte_array;
-    uint32_t length         = BF_HTONL(src_bitset->length);
-    uint64_t bitcount       = 0;
-    BloomFilter *bloomFilter= NULL;
-    BitSetHeader *bitset    = NULL;
-    uint64_t *src_data      = NULL;
-    uint64_t *dst_data      = NULL;
+    uint8_t bytes[4];
 
-    bitset = (BitSetHeader *)malloc(sizeof(uint64_t) * length + HEADER_LEN);
-    memset(bitset, 0, sizeof(uint64_t) * length + HEADER_LEN);
+    int32Bytes(sn, bytes);
 
-    bitset->magic = src_bitset->magic;
-    bitset->hash_num = src_bitset->hash_num;
-    bitset->length = length;
+    return MightContainBytes(bf, bytes, sizeof(bytes));
+}
 
-    dst_data = (uint64_t *)((void *)bitset + HEADER_LEN);
-    src_data = (uint64_t *)((uint8_t *)byte_array + HEADER_LEN);
+//hash a group of keys, remember their first probes and prefetch them.
+void batchPrefetch(BloomFilter *bf, const uint8_t *data, const uint64_t *keys, size_t n,
+                   uint64_t (*hashes)[2], uint64_t (*probes)[BF_BATCH_PROBES], int rw)
+{
+    int hash_num        = bf->bitset->hash_num;
+    int prefetch_num    = hash_num < BF_BATCH_PROBES ? hash_num : BF_BATCH_PROBES;
+
+    for (size_t j = 0; j < n; j++) {
+        hashUint64(bf, *(keys + j), *(hashes + j));
+        bf->strategy->indexes(bf, data, hashes[j][0], hashes[j][1], *(probes + j), prefetch_num);
+
+        for (int i = 0; i < prefetch_num; i++) {
+            if (rw) {
+                __builtin_prefetch(data + (probes[j][i] >> 3), 1);
+            } else {
+                __builtin_prefetch(data + (probes[j][i] >> 3), 0);
+            }
+        }
+    }
+}
 
-    for (int i = 0; i < length; i++) {
-        *(dst_data + i) = BF_NTOHLL( *(src_data + i));
-        bitcount += bitCount(*(dst_data + i));
+size_t MightContainNumberBatch(BloomFilter *bf, const uint64_t *keys, size_t n, uint8_t *out)
+{
+    uint64_t hashes[BF_BATCH][2];
+    uint64_t probes[BF_BATCH][BF_BATCH_PROBES];
+    int hash_num            = 0;
+    size_t hits             = 0;
+
+    if (NULL == bf || NULL == bf->bitset || NULL == bf->hash_func) {
+        return 0;
     }
 
-    bloomFilter = (BloomFilter *)malloc(sizeof(BloomFilter));
-    bloomFilter->seed = 0;
-    bloomFilter->bit_count = bitcount;
-    bloomFilter->hash_func = MurmurHash3_x64_128;
-    bloomFilter->bitset = bitset;
+    if (NULL == keys || NULL == out || bf->bitset->hash_num == 0) {
+        return 0;
+    }
 
-    return bloomFilter;
-}
+    hash_num = bf->bitset->hash_num;
 
-void DestroyBF(BloomFilter *bf)
-{
-    if(bf != NULL) {
-        if (bf->bitset != NULL) {
-            free(bf->bitset);
+    for (size_t base = 0; base < n; base += BF_BATCH) {
+        size_t group = n - base < BF_BATCH ? n - base : BF_BATCH;
+        //one read section a group, a replace waits for one group at most.
+        uint64_t *readers = readEnter(bf);
+        const uint8_t *data = readData(bf);
+
+        batchPrefetch(bf, data, keys + base, group, hashes, probes, 0);
+
+        for (size_t j = 0; j < group; j++) {
+            int is_in = 1;
+
+            //a fuse filter xors its probes instead of testing bits.
+            if (hash_num > BF_BATCH_PROBES || bf->bitset->magic == BF_MAGIC_FUSE) {
+                is_in = bf->strategy->contain(bf, data, hashes[j][0], hashes[j][1]);
+            } else {
+                for (int i = 0; i < hash_num && is_in; i++) {
+                    if (bf->mode == BF_MODE_VIEW) {
+                        is_in = BitsGetBE(data, probes[j][i]);
+                    } else {
+                        is_in = BitsGet((uint64_t *)data, probes[j][i]);
+                    }
+                }
+            }
+
+            *(out + base + j) = (uint8_t)is_in;
+            hits += is_in;
         }
-        free(bf);
+
+        readExit(readers);
     }
+
+    return hits;
 }
 
-int PutStrNumber(BloomFilter *bf, StrNumber sn)
+size_t PutUint64Batch(BloomFilter *bf, const uint64_t *keys, size_t n)
 {
-    uint8_t byte_array[8]   = {0};
-    uint64_t key            = (uint64_t)atoll((const char *)sn.str);
-    uint64_t out[2]         = {0};
-    uint64_t h1             = 0;
-    uint64_t h2             = 0;
-    uint64_t combine        = 0;
-    uint64_t bit_size       = 0;
+    uint64_t hashes[BF_BATCH][2];
+    uint64_t probes[BF_BATCH][BF_BATCH_PROBES];
     int hash_num            = 0;
-    int bits_changed        = 0;
-    int res                 = 0;
+    size_t changed          = 0;
 
-    if (NULL == bf) {
+    if (NULL == bf || NULL == bf->bitset || NULL == bf->hash_func) {
         return 0;
     }
 
-    if (NULL == bf->hash_func) {
+    if (NULL == keys || !writable(bf)) {
         return 0;
     }
 
-    bit_size = bf->bitset->length * 64;
     hash_num = bf->bitset->hash_num;
 
-    //little endian
-    for (int i = 0; i < 8; i++) {
-        *(byte_array + i) = (uint8_t)(key >> (i * 8));
+    for (size_t base = 0; base < n; base += BF_BATCH) {
+        size_t group = n - base < BF_BATCH ? n - base : BF_BATCH;
+        uint64_t *readers = readEnter(bf);
+        uint8_t *data = readData(bf);
+
+        batchPrefetch(bf, data, keys + base, group, hashes, probes, 1);
+
+        for (size_t j = 0; j < group; j++) {
+            int bits_changed = 0;
+
+            if (hash_num > BF_BATCH_PROBES) {
+                changed += bf->strategy->put(bf, data, hashes[j][0], hashes[j][1]);
+                continue;
+            }
+
+            for (int i = 0; i < hash_num; i++) {
+                bits_changed |= BitsSet(bf, data, probes[j][i]);
+            }
+
+            changed += bits_changed;
+        }
+
+        readExit(readers);
     }
 
-    bf->hash_func(byte_array, 8, bf->seed , out);
+    return changed;
+}
+
+/*
+ * Bulk build. Every round each thread hashes BF_BUILD_CHUNK keys into bit
+ * indexes and radix sorts them by owner, thread t owning the t-th word
+ * range of the bitset. After a barrier each thread sets the bits of its
+ * own range from all threads' buckets, so no word has two writers.
+ */
 
-    h1 = *out;
-    h2 = *(out + 1);
+typedef struct {
+    BloomFilter *bf;
+    const uint64_t *keys;
+    size_t n;
+    int threads;
+    int hash_num;
+    pthread_barrier_t barrier;
+
+    //held while threads start, aborted->some failed to.
+    pthread_mutex_t start;
+    int aborted;
+
+    //per thread: raw indexes, indexes by owner, and owner offsets.
+    uint64_t **probes;
+    uint64_t **sorted;
+    size_t **offsets;
+    uint64_t *bit_counts;
+} BuildContext;
+
+typedef struct {
+    BuildContext *ctx;
+    int id;
+} BuildWorker;
+
+static void *buildWorker(void *arg)
+{
+    BuildWorker *worker     = (BuildWorker *)arg;
+    BuildContext *ctx       = worker->ctx;
+    BloomFilter *bf         = ctx->bf;
+    int id                  = worker->id;
+    int threads             = ctx->threads;
+    int hash_num            = ctx->hash_num;
+    uint64_t length         = bf->bitset->length;
+    uint64_t *data          = (uint64_t *)bf->data;
+    uint64_t *probes        = *(ctx->probes + id);
+    uint64_t *sorted        = *(ctx->sorted + id);
+    size_t *offsets         = *(ctx->offsets + id);
+    size_t round_keys       = (size_t)threads * BF_BUILD_CHUNK;
+    uint64_t bit_count      = 0;
+
+    pthread_mutex_lock(&ctx->start);
+    pthread_mutex_unlock(&ctx->start);
+    if (ctx->aborted) {
+        return NULL;
+    }
 
-    combine = h1;
+    for (size_t round = 0; round < ctx->n; round += round_keys) {
+        size_t begin = round + (size_t)id * BF_BUILD_CHUNK;
+        size_t count = 0;
+        size_t probe_num = 0;
 
-    for (int i = 0; i < hash_num; i++) {
-        uint64_t bit_index = (combine & INT64_MAX) % bit_size;
-        res = BitsSet(bf, bit_index);
-        bits_changed |= res;
-        combine += h2;
+        if (begin < ctx->n) {
+            count = ctx->n - begin < BF_BUILD_CHUNK ? ctx->n - begin : BF_BUILD_CHUNK;
+        }
+        probe_num = count * hash_num;
+
+        for (size_t j = 0; j < count; j++) {
+            uint64_t out[2] = {0};
+
+            hashUint64(bf, *(ctx->keys + begin + j), out);
+            bf->strategy->indexes(bf, (const uint8_t *)data, *out, *(out + 1), probes + j * hash_num, hash_num);
+        }
+
+        memset(offsets, 0, sizeof(size_t) * (threads + 1));
+        for (size_t i = 0; i < probe_num; i++) {
+            offsets[((*(probes + i) >> 6) * threads) / length + 1]++;
+        }
+        for (int t = 0; t < threads; t++) {
+            offsets[t + 1] += offsets[t];
+        }
+        for (size_t i = 0; i < probe_num; i++) {
+            int owner = ((*(probes + i) >> 6) * threads) / length;
+
+            *(sorted + offsets[owner]++) = *(probes + i);
+        }
+        //scattering advanced each offset to the next owner's start.
+        for (int t = threads; t > 0; t--) {
+            offsets[t] = offsets[t - 1];
+        }
+        offsets[0] = 0;
+
+        pthread_barrier_wait(&ctx->barrier);
+
+        for (int t = 0; t < threads; t++) {
+            const uint64_t *bucket = *(ctx->sorted + t);
+            const size_t *bucket_offsets = *(ctx->offsets + t);
+
+            for (size_t i = bucket_offsets[id]; i < bucket_offsets[id + 1]; i++) {
+                uint64_t *word = data + (*(bucket + i) >> 6);
+                uint64_t mask = (uint64_t)1 << (*(bucket + i) & 63);
+
+                bit_count += (*word & mask) == 0;
+                *word |= mask;
+            }
+        }
+
+        pthread_barrier_wait(&ctx->barrier);
     }
 
-    return bits_changed;
+    *(ctx->bit_counts + id) = bit_count;
+
+    return NULL;
 }
 
-int PutUint64(BloomFilter *bf, double sn)
+BloomFilter *BuildBF(const uint64_t *keys, size_t n, double fpp, int threads)
 {
-    uint8_t byte_array[8]   = {0};
-    uint64_t key            = (uint64_t)sn;
-    uint64_t out[2]         = {0};
-    uint64_t h1             = 0;
-    uint64_t h2             = 0;
-    uint64_t combine        = 0;
-    uint64_t bit_size       = 0;
-    int hash_num            = 0;
-    int bits_changed        = 0;
-    int res                 = 0;
+    BloomFilter *bf         = NULL;
+    BuildContext ctx;
+    BuildWorker workers[BF_BUILD_MAX_THREADS];
+    pthread_t tids[BF_BUILD_MAX_THREADS];
+    int started             = 0;
+    int ok                  = 1;
+
+    if (NULL == keys && n > 0) {
+        return NULL;
+    }
 
+    bf = NewBF(n, fpp);
     if (NULL == bf) {
-        return 0;
+        return NULL;
     }
 
-    if (NULL == bf->hash_func) {
-        return 0;
+    if (threads <= 0) {
+        threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    if (threads > BF_BUILD_MAX_THREADS) {
+        threads = BF_BUILD_MAX_THREADS;
+    }
+    //every owner range needs at least one long.
+    if ((uint64_t)threads > bf->bitset->length) {
+        threads = (int)bf->bitset->length;
+    }
+    if (threads <= 0) {
+        threads = 1;
     }
 
-    bit_size = bf->bitset->length * 64;
-    hash_num = bf->bitset->hash_num;
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.bf = bf;
+    ctx.keys = keys;
+    ctx.n = n;
+    ctx.threads = threads;
+    ctx.hash_num = bf->bitset->hash_num;
+    ctx.probes = (uint64_t **)calloc(threads, sizeof(uint64_t *));
+    ctx.sorted = (uint64_t **)calloc(threads, sizeof(uint64_t *));
+    ctx.offsets = (size_t **)calloc(threads, sizeof(size_t *));
+    ctx.bit_counts = (uint64_t *)calloc(threads, sizeof(uint64_t));
+
+    if (NULL == ctx.probes || NULL == ctx.sorted || NULL == ctx.offsets || NULL == ctx.bit_counts) {
+        ok = 0;
+    }
 
-    //little endian
-    for (int i = 0; i < 8; i++) {
-        *(byte_array + i) = (uint8_t)(key >> (i * 8));
+    for (int t = 0; ok && t < threads; t++) {
+        *(ctx.probes + t) = (uint64_t *)malloc(sizeof(uint64_t) * BF_BUILD_CHUNK * ctx.hash_num);
+        *(ctx.sorted + t) = (uint64_t *)malloc(sizeof(uint64_t) * BF_BUILD_CHUNK * ctx.hash_num);
+        *(ctx.offsets + t) = (size_t *)malloc(sizeof(size_t) * (threads + 1));
+
+        if (NULL == *(ctx.probes + t) || NULL == *(ctx.sorted + t) || NULL == *(ctx.offsets + t)) {
+            ok = 0;
+        }
     }
 
-    bf->hash_func(byte_array, 8, bf->seed , out);
+    if (ok && pthread_barrier_init(&ctx.barrier, NULL, threads) != 0) {
+        ok = 0;
+    }
 
-    h1 = *out;
-    h2 = *(out + 1);
+    if (ok) {
+        pthread_mutex_init(&ctx.start, NULL);
+        pthread_mutex_lock(&ctx.start);
 
-    combine = h1;
+        for (int t = 0; t < threads; t++) {
+            workers[t].ctx = &ctx;
+            workers[t].id = t;
+        }
 
-    for (int i = 0; i < hash_num; i++) {
-        uint64_t bit_index = (combine & INT64_MAX) % bit_size;
-        res = BitsSet(bf, bit_index);
-        bits_changed |= res;
-        combine += h2;
+        //the calling thread works as thread 0.
+        for (started = 1; started < threads; started++) {
+            if (pthread_create(tids + started, NULL, buildWorker, workers + started) != 0) {
+                break;
+            }
+        }
+
+        //the barrier would never fill, send the started ones home.
+        ctx.aborted = started < threads;
+        pthread_mutex_unlock(&ctx.start);
+
+        if (!ctx.aborted) {
+            buildWorker(workers);
+        }
+
+        for (int t = 1; t < started; t++) {
+            pthread_join(tids[t], NULL);
+        }
+
+        pthread_mutex_destroy(&ctx.start);
+        pthread_barrier_destroy(&ctx.barrier);
+        ok = !ctx.aborted;
     }
 
-    return bits_changed;
+    if (ok) {
+        for (int t = 0; t < threads; t++) {
+            bf->bit_count += *(ctx.bit_counts + t);
+        }
+    }
+
+    for (int t = 0; t < threads; t++) {
+        if (NULL != ctx.probes) free(*(ctx.probes + t));
+        if (NULL != ctx.sorted) free(*(ctx.sorted + t));
+        if (NULL != ctx.offsets) free(*(ctx.offsets + t));
+    }
+    free(ctx.probes);
+    free(ctx.sorted);
+    free(ctx.offsets);
+    free(ctx.bit_counts);
+
+    if (!ok) {
+        DestroyBF(bf);
+        return NULL;
+    }
+
+    return bf;
 }
 
-int MightContainStrNumber(BloomFilter *bf, StrNumber sn)
+static int fuseCompare(const void *a, const void *b)
 {
-    uint8_t byte_array[8]   = {0};
-    uint64_t key            = (uint64_t)atoll((const char *)sn.str);
-    uint64_t out[2]         = {0};
-    uint64_t h1             = 0;
-    uint64_t h2             = 0;
-    uint64_t combine        = 0;
-    uint64_t *data          = NULL;
-    uint64_t bit_size       = 0;
-    int hash_num            = 0;
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
 
-    if (NULL == bf) {
-        return 0;
+    return x < y ? -1 : x > y;
+}
+
+BF_ALWAYS_INLINE uint64_t fuseMod3(uint64_t x)
+{
+    return x > 2 ? x - 3 : x;
+}
+
+/*
+ * Peel the 3-hypergraph of the hashes: a slot hit by one key alone fixes
+ * that key, which then leaves its other 2 slots. t2count keeps 4 times
+ * the keys on a slot plus the xor of which of their 3 slots it was, t2hash
+ * the xor of their hashes, so the last key of a slot is at hand. Keys are
+ * first sorted by segment, which keeps the counts in cache.
+ */
+
+static int fusePeel(const uint64_t *hashes, size_t size, uint64_t seed, uint64_t segment_length,
+                    uint64_t segment_count, uint64_t segment_count_length, uint64_t capacity,
+                    uint64_t *reverse_order, uint8_t *reverse_h, uint64_t *alone,
+                    uint8_t *t2count, uint64_t *t2hash, uint64_t *start_pos)
+{
+    uint64_t slots[BF_FUSE_ARITY + 2];
+    uint64_t block_bits     = 1;
+    uint64_t block          = 0;
+    size_t queue            = 0;
+    size_t stack            = 0;
+
+    while (((uint64_t)1 << block_bits) < segment_count) {
+        block_bits++;
     }
+    block = (uint64_t)1 << block_bits;
 
-    if (NULL == bf->bitset) {
-        return 0;
+    memset(reverse_order, 0, sizeof(uint64_t) * size);
+    *(reverse_order + size) = 1;
+    memset(t2count, 0, capacity);
+    memset(t2hash, 0, sizeof(uint64_t) * capacity);
+
+    for (uint64_t i = 0; i < block; i++) {
+        *(start_pos + i) = (uint64_t)(((unsigned __int128)i * size) >> block_bits);
     }
 
-    if (NULL == bf->hash_func) {
-        return 0;
+    for (size_t i = 0; i < size; i++) {
+        uint64_t hash = fuseMix(*(hashes + i), seed);
+        uint64_t segment = hash >> (64 - block_bits);
+
+        while (*(reverse_order + *(start_pos + segment)) != 0) {
+            segment = (segment + 1) & (block - 1);
+        }
+        *(reverse_order + *(start_pos + segment)) = hash;
+        (*(start_pos + segment))++;
     }
 
-    if (bf->bitset->hash_num == 0) {
-        return 0;
+    for (size_t i = 0; i < size; i++) {
+        uint64_t hash = *(reverse_order + i);
+
+        fuseSlots(hash, segment_length, segment_count_length, slots);
+        for (int j = 0; j < BF_FUSE_ARITY; j++) {
+            //the count of a slot wrapped past 63 keys.
+            if (*(t2count + slots[j]) >= 252) {
+                return 0;
+            }
+            *(t2count + slots[j]) += 4;
+            *(t2count + slots[j]) ^= (uint8_t)j;
+            *(t2hash + slots[j]) ^= hash;
+        }
     }
 
-    /*
-    if (bf->bitset->length < 10) {
-        return 0;
+    for (uint64_t i = 0; i < capacity; i++) {
+        *(alone + queue) = i;
+        queue += (*(t2count + i) >> 2) == 1;
     }
-    */
 
-    bit_size = bf->bitset->length * 64;
-    hash_num = bf->bitset->hash_num;
-    data = (uint64_t *)((void *)bf->bitset + HEADER_LEN);
+    while (queue > 0) {
+        uint64_t index = *(alone + --queue);
+        uint64_t hash = 0;
+        uint8_t found = 0;
 
-    //little endian
-    for (int i = 0; i < 8; i++) {
-        *(byte_array + i) = (uint8_t)(key >> (i * 8));
-    }
+        if ((*(t2count + index) >> 2) != 1) {
+            continue;
+        }
 
-    bf->hash_func(byte_array, 8, bf->seed , out);
-    h1 = *out;
-    h2 = *(out + 1);
+        hash = *(t2hash + index);
+        found = *(t2count + index) & 3;
+        *(reverse_h + stack) = found;
+        *(reverse_order + stack) = hash;
+        stack++;
 
-    combine = h1;
+        fuseSlots(hash, segment_length, segment_count_length, slots);
+        slots[3] = slots[0];
+        slots[4] = slots[1];
 
-    for (int i = 0; i < hash_num; i++) {
-        uint64_t bit_index = (combine & INT64_MAX) % bit_size;
+        for (int j = 1; j < BF_FUSE_ARITY; j++) {
+            uint64_t other = slots[found + j];
 
-        if (!BitsGet(data, bit_index)) {
-            return 0;
+            *(alone + queue) = other;
+            queue += (*(t2count + other) >> 2) == 2;
+            *(t2count + other) -= 4;
+            *(t2count + other) ^= (uint8_t)fuseMod3(found + j);
+            *(t2hash + other) ^= hash;
         }
-
-        combine = combine + h2;
     }
 
-    return 1;
+    return stack == size;
 }
 
-int MightContainNumber(BloomFilter *bf, double sn)
+BloomFilter *BuildFuseBF(const uint64_t *keys, size_t n)
 {
-    uint8_t byte_array[8]   = {0};
-    uint64_t key            = (uint64_t)sn;
-    uint64_t out[2]         = {0};
-    uint64_t h1             = 0;
-    uint64_t h2             = 0;
-    uint64_t combine        = 0;
-    uint64_t *data          = NULL;
-    uint64_t bit_size       = 0;
-    int hash_num            = 0;
+    BloomFilter *bf                 = NULL;
+    BitSetHeader *bitset            = NULL;
+    uint64_t *hashes                = NULL;
+    uint64_t *reverse_order         = NULL;
+    uint8_t *reverse_h              = NULL;
+    uint64_t *alone                 = NULL;
+    uint8_t *t2count                = NULL;
+    uint64_t *t2hash                = NULL;
+    uint64_t *start_pos             = NULL;
+    uint64_t *data                  = NULL;
+    uint8_t *fingerprints           = NULL;
+    uint64_t slots[BF_FUSE_ARITY + 2];
+    uint64_t segment_length         = 4;
+    uint64_t segment_count          = 1;
+    uint64_t segment_count_length   = 0;
+    uint64_t capacity               = 0;
+    uint64_t length                 = 0;
+    uint64_t seed                   = 0;
+    uint64_t rng                    = 0x726b2b9d438b9d4dULL;
+    size_t size                     = 0;
+    int built                       = 0;
+
+    if (NULL == keys && n > 0) {
+        return NULL;
+    }
 
-    if (NULL == bf) {
-        return 0;
+    hashes = (uint64_t *)malloc(sizeof(uint64_t) * (n + 1));
+    if (NULL == hashes) {
+        return NULL;
     }
 
-    if (NULL == bf->bitset) {
-        return 0;
+    //a repeated h1 hits the same 3 slots, and never peels.
+    for (size_t i = 0; i < n; i++) {
+        uint64_t out[2] = {0};
+
+        MurmurHash3_x64_128_u64(*(keys + i), 0, out);
+        *(hashes + i) = *out;
+    }
+    qsort(hashes, n, sizeof(uint64_t), fuseCompare);
+    for (size_t i = 0; i < n; i++) {
+        if (size == 0 || *(hashes + i) != *(hashes + size - 1)) {
+            *(hashes + size++) = *(hashes + i);
+        }
     }
 
-    if (NULL == bf->hash_func) {
-        return 0;
+    if (size > 1) {
+        double size_factor = fmax(1.125, 0.875 + 0.25 * log(1000000.0) / log((double)size));
+        uint64_t sized = (uint64_t)round((double)size * size_factor);
+
+        segment_length = (uint64_t)1 << (int)floor(log((double)size) / log(3.33) + 2.25);
+        if (segment_length > BF_FUSE_MAX_SEGMENT) {
+            segment_length = BF_FUSE_MAX_SEGMENT;
+        }
+
+        segment_count = (sized + segment_length - 1) / segment_length;
+        segment_count = segment_count > BF_FUSE_ARITY - 1 ? segment_count - (BF_FUSE_ARITY - 1) : 1;
     }
 
-    if (bf->bitset->hash_num == 0) {
-        return 0;
+    segment_count_length = segment_count * segment_length;
+    capacity = (segment_count + BF_FUSE_ARITY - 1) * segment_length;
+    length = BF_FUSE_PARAMS + (capacity + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+    if (length > UINT32_MAX) {
+        free(hashes);
+        return NULL;
     }
 
-    /*
-    if (bf->bitset->length < 10) {
-        return 0;
+    reverse_order = (uint64_t *)malloc(sizeof(uint64_t) * (size + 1));
+    reverse_h = (uint8_t *)malloc(size + 1);
+    alone = (uint64_t *)malloc(sizeof(uint64_t) * capacity);
+    t2count = (uint8_t *)malloc(capacity);
+    t2hash = (uint64_t *)malloc(sizeof(uint64_t) * capacity);
+    start_pos = (uint64_t *)malloc(sizeof(uint64_t) * 2 * segment_count);
+    if (NULL == reverse_order || NULL == reverse_h || NULL == alone || NULL == t2count
+            || NULL == t2hash || NULL == start_pos) {
+        goto done;
     }
-    */
 
-    bit_size = bf->bitset->length * 64;
-    hash_num = bf->bitset->hash_num;
-    data = (uint64_t *)((void *)bf->bitset + HEADER_LEN);
+    for (int i = 0; i < BF_FUSE_MAX_ITERATIONS && !built; i++) {
+        //splitmix64, a new seed a try.
+        rng += 0x9e3779b97f4a7c15ULL;
+        seed = fuseMix(rng, 0);
+        built = fusePeel(hashes, size, seed, segment_length, segment_count, segment_count_length,
+                         capacity, reverse_order, reverse_h, alone, t2count, t2hash, start_pos);
+    }
 
-    //little endian
-    for (int i = 0; i < 8; i++) {
-        *(byte_array + i) = (uint8_t)(key >> (i * 8));
+    if (!built) {
+        goto done;
     }
 
-    bf->hash_func(byte_array, 8, bf->seed , out);
-    h1 = *out;
-    h2 = *(out + 1);
+    bitset = allocBitset((uint32_t)length);
+    if (NULL == bitset) {
+        goto done;
+    }
 
-    combine = h1;
+    bitset->magic = BF_MAGIC_FUSE;
+    bitset->hash_num = BF_FUSE_ARITY;
+    bitset->length = (uint32_t)length;
 
-    for (int i = 0; i < hash_num; i++) {
-        uint64_t bit_index = (combine & INT64_MAX) % bit_size;
+    bf = (BloomFilter *)calloc(1, sizeof(BloomFilter));
+    if (NULL == bf) {
+        freeBitset(bitset);
+        goto done;
+    }
 
-        if (!BitsGet(data, bit_index)) {
-            return 0;
-        }
+    bf->seed = 0;
+    bf->bit_count = 0;
+    bf->hash_func = MurmurHash3_x64_128;
+    //readers never follow bitset into longs a replace may free.
+    bf->header = *bitset;
+    bf->bitset = &bf->header;
+    bf->data = (uint8_t *)bitset + HEADER_LEN;
+    bf->mode = BF_MODE_OWNED;
+    bf->strategy = findStrategy(BF_MAGIC_FUSE, BF_FUSE_ARITY);
+
+    data = (uint64_t *)bf->data;
+    *data = seed;
+    *(data + 1) = segment_length;
+    *(data + 2) = segment_count_length;
+    fingerprints = bf->data + BF_FUSE_PARAMS * sizeof(uint64_t);
+
+    //the last peeled goes first: its other 2 slots are final by then.
+    for (size_t i = size; i-- > 0;) {
+        uint64_t hash = *(reverse_order + i);
+        uint8_t found = *(reverse_h + i);
+
+        fuseSlots(hash, segment_length, segment_count_length, slots);
+        slots[3] = slots[0];
+        slots[4] = slots[1];
+        *(fingerprints + slots[found]) = fuseFingerprint(hash)
+            ^ *(fingerprints + slots[found + 1]) ^ *(fingerprints + slots[found + 2]);
+    }
 
-        combine = combine + h2;
+    for (uint64_t i = 0; i < length; i++) {
+        bf->bit_count += __builtin_popcountll(*(data + i));
     }
 
-    return 1;
-}
+done:
+    free(hashes);
+    free(reverse_order);
+    free(reverse_h);
+    free(alone);
+    free(t2count);
+    free(t2hash);
+    free(start_pos);
 
+    return bf;
+}
@@ -95,6 +95,9 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
     (*(uint8_t *)(b + 6)) = (uint8_t)(v >> 8);     \
     (*(uint8_t *)(b + 7)) = (uint8_t)(v);
 
+//byte of a big endian long that holds bit (i & 63) is (i >> 3) ^ 7.
+#define BF_BE_BYTE_SWIZZLE  7
+
 #elif __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
 
 #define BF_NTOHL(x)        (x)
@@ -108,6 +111,8 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define BF_HTONLL_ARRAY(b, v) \
         (*b = BF_HTONLL(v));
 
+#define BF_BE_BYTE_SWIZZLE  0
+
 #else
 #error unspecified endianness
 #endif
@@ -138,10 +143,126 @@ typedef struct {
 
     //N big endian longs of the bitset behind.
 } BitSetHeader;
-#pragma unpack()
+#pragma pack()
 
 #define HEADER_LEN      (sizeof(BitSetHeader))
 
+//Guava BloomFilterStrategies.MURMUR128_MITZ_64, (combine & INT64_MAX) % bit_size.
+#define BF_MAGIC_GUAVA      1
+//Lemire multiply-shift range reduction, no division. Not readable by Guava.
+#define BF_MAGIC_FASTRANGE  2
+//Power of two bit size, the index is combine masked. Not readable by Guava.
+#define BF_MAGIC_POW2       3
+//Cache line blocked, all probes of a key in one BF_BLOCK_BITS block.
+#define BF_MAGIC_BLOCKED    4
+
+//Split block (Parquet SBBF), one bit in each 32 bit lane of a 256 bit block.
+#define BF_MAGIC_SPLIT_BLOCK    5
+
+//Not an index strategy, the 4 bit counters of a CountingBF (countingbf.h).
+#define BF_MAGIC_COUNTING   6
+
+//Not an index strategy, a ScalableBF chain of guava filters (scalablebf.h).
+#define BF_MAGIC_SCALABLE   7
+
+//Not an index strategy, a CuckooFilter (cuckoofilter.h).
+#define BF_MAGIC_CUCKOO     8
+
+//Not an index strategy, an AgingBF of generations (agingbf.h).
+#define BF_MAGIC_AGING      10
+
+//Binary fuse filter of BuildFuseBF, a static one: no puts.
+#define BF_MAGIC_FUSE       9
+
+//Longs ahead of the fingerprints: seed, segment length, segment count length.
+#define BF_FUSE_PARAMS      3
+#define BF_FUSE_ARITY       3
+#define BF_FUSE_MAX_SEGMENT 262144
+#define BF_FUSE_MAX_ITERATIONS  100
+
+#define BF_BLOCK_BITS       512
+#define BF_BLOCK_WORDS      (BF_BLOCK_BITS / 64)
+
+#define BF_SPLIT_BLOCK_BITS     256
+#define BF_SPLIT_BLOCK_WORDS    (BF_SPLIT_BLOCK_BITS / 64)
+
+//Probe loops of one magic, see bloomfilter.c.
+struct BFStrategy;
+
+//bit_count stripes of a concurrent filter, each long alone on a cache line.
+#define BF_COUNTER_STRIPES  64
+#define BF_COUNTER_STRIDE   8
+
+//a shared filter: BitSetFileHeader, the counter stripes, then the longs.
+#define BF_SHARED_DATA_OFFSET   (BF_FILE_DATA_OFFSET + BF_COUNTER_STRIPES * BF_COUNTER_STRIDE * 8)
+
+//bitset and data are owned, data is in host order.
+#define BF_MODE_OWNED   0
+//read only, data points to a borrowed big endian byte array.
+#define BF_MODE_VIEW    1
+//read only, data points into a MAP_SHARED bloom file, in host order.
+#define BF_MODE_MAPPED  2
+//writable by many processes, data points into a MAP_SHARED mapping, in host order.
+#define BF_MODE_SHARED  3
+
+//Not a Guava strategy ordinal, tells a bloom file from the redis format.
+#define BF_FILE_MAGIC       ((int8_t)0xBF)
+#define BF_FILE_VERSION     1
+#define BF_FILE_BYTE_ORDER  0x01020304
+//The longs start on a cache line of the page aligned mapping.
+#define BF_FILE_DATA_OFFSET 64
+
+//Tells a delta of SerializeDelta from a full filter.
+#define BF_DELTA_MAGIC      ((int8_t)0xBD)
+#define BF_DELTA_HEADER_LEN 12
+#define BF_DELTA_RANGE_LEN  9
+//Range ops: OR the longs in, or store them over the receiver's.
+#define BF_DELTA_OR         0
+#define BF_DELTA_OVERWRITE  1
+//Longs behind one dirty bit, a cache line.
+#define BF_DIRTY_WORDS      8
+
+//Tells a sparse blob of SerializeCompact from the guava format.
+#define BF_SPARSE_MAGIC     ((int8_t)0xB5)
+#define BF_SPARSE_HEADER_LEN 7
+
+typedef struct {
+    //BF_FILE_MAGIC.
+    int8_t  magic;
+
+    //BF_FILE_VERSION.
+    uint8_t version;
+
+    //The BitSetHeader magic of the filter.
+    int8_t  strategy;
+
+    //Number of hash functions.
+    uint8_t hash_num;
+
+    //BF_FILE_BYTE_ORDER in the writer's order, the longs are in the same order.
+    uint32_t byte_order;
+
+    //The number of longs in the bitset.
+    uint32_t length;
+
+    //seed
+    uint32_t seed;
+
+    //Number of set bits.
+    uint64_t bit_count;
+
+    //Checksum of the longs, see WriteBFFile.
+    uint64_t checksum;
+
+    //BF_FILE_DATA_OFFSET.
+    uint32_t data_offset;
+
+    //zero, pads the header to data_offset.
+    uint8_t reverse[28];
+
+    //N host order longs of the bitset behind.
+} BitSetFileHeader;
+
 typedef struct {
     //seed
     uint32_t seed;
@@ -154,6 +275,32 @@ typedef struct {
 
     //bitset
     BitSetHeader *bitset;
+
+    //the longs of the bitset, layout depends on mode.
+    uint8_t *data;
+
+    //BF_MODE_*
+    uint8_t mode;
+
+    //host order copy of the header, bitset points here.
+    BitSetHeader header;
+
+    //probe loops picked by bitset->magic.
+    const struct BFStrategy *strategy;
+
+    //1->puts from many threads, see SetConcurrentBF.
+    uint8_t concurrent;
+
+    //BF_COUNTER_STRIPES set bit counters added to bit_count, or NULL.
+    //Longs 1 and 2 of a stripe count the readers, see ReplaceBitsetBF.
+    uint64_t *counters;
+
+    //bumped by each ReplaceBitsetBF of a concurrent filter.
+    uint64_t epoch;
+
+    //one bit per BF_DIRTY_WORDS longs changed since the last delta, then
+    //one per line that lost bits, or NULL.
+    uint64_t *dirty;
 } BloomFilter;
 
 
@@ -205,11 +352,67 @@ int OptimalNumOfHash(uint64_t n, uint64_t m);
  *  array_len   : length of byte array.
  *
  * @return
- *  bf          : A bloom filter struct ptr.
+ *  bf          : A bloom filter struct ptr. NULL->unknown magic, short
+ *                array, or a length the magic's layout does not fit.
  */
 
 BloomFilter *LoadBF(void *byte_array, double array_len);
 
+/*
+ * @Description : Create a read only bloom filter over a byte array from
+ *                redis, without copying or byte swapping the bitset.
+ *                The byte array must outlive the returned filter, and
+ *                bit_count is not counted to keep the load O(1).
+ * @Date        : 2026-10-17
+ * @Author      : Xiangqian5
+ * @Software    : Weibo Inc.
+ *
+ * @param
+ *  byte_array  : A big endian byte array from redis.
+ *  array_len   : length of byte array.
+ *
+ * @return
+ *  bf          : A bloom filter struct ptr. NULL->invalid byte array or magic,
+ *                or a length the magic's layout does not fit.
+ */
+
+BloomFilter *ViewBF(const void *byte_array, size_t array_len);
+
+/*
+ * @Description : Map a bloom file written by WriteBFFile read only and
+ *                shared, so every process loading the same file shares
+ *                one copy of the bitset in the page cache.
+ * @Date        : 2026-10-17
+ * @Author      : Xiangqian5
+ * @Software    : Weibo Inc.
+ *
+ * @param
+ *  path        : The bloom file.
+ *
+ * @return
+ *  bf          : A read only bloom filter. NULL->invalid file or checksum.
+ */
+
+BloomFilter *LoadBFFromFile(const char *path);
+
+/*
+ * @Description : Write a bloom filter to a file in host byte order, for
+ *                LoadBFFromFile. The file is written aside and renamed
+ *                over path, so processes mapping the old file keep it.
+ * @Date        : 2026-10-17
+ * @Author      : Xiangqian5
+ * @Software    : Weibo Inc.
+ *
+ * @param
+ *  bf          : The bloom filter to storage.
+ *  path        : The bloom file.
+ *
+ * @return
+ *  ok          : 0->fail. 1->ok.
+ */
+
+int WriteBFFile(BloomFilter *bf, const char *path);
+
 /*
  * @Description : New a bloom filter instance.
  * @Date        : 2020-05-15
@@ -226,6 +429,258 @@ BloomFilter *LoadBF(void *byte_array, double array_len);
 
 BloomFilter *NewBF(uint64_t expect, double fpp);
 
+/*
+ * @Description : New a bloom filter instance with the given index strategy.
+ *                BF_MAGIC_FASTRANGE and BF_MAGIC_POW2 skip the 64 bit
+ *                division of every probe, for filters Java never reads.
+ *                BF_MAGIC_POW2 rounds the bitset up to a power of two.
+ * @Date        : 2026-10-17
+ * @Author      : Xiangqian5
+ * @Software    : Weibo Inc.
+ *
+ * @param:
+ *  expect      : number of bloom elements.
+ *  fpp         : positive percent.
+ *  magic       : BF_MAGIC_*.
+ *
+ * @return:
+ *  bf          : pointer of bloom filter. NULL->unknown magic.
+ */
+
+BloomFilter *NewBFStrategy(uint64_t expect, double fpp, int8_t magic);
+
+/*
+ * @Description : New a cache line blocked bloom filter (BF_MAGIC_BLOCKED).
+ *                A lookup touches one 64 byte block whatever the hash
+ *                number, and the bitset is sized up until the blocked
+ *                false positive rate still meets fpp.
+ * @Date        : 2026-10-17
+ * @Author      : Xiangqian5
+ * @Software    : Weibo Inc.
+ *
+ * @param:
+ *  expect      : number of bloom elements.
+ *  fpp         : positive percent.
+ *
+ * @return:
+ *  bf          : pointer of bloom filter.
+ */
+
+BloomFilter *NewBlockedBF(uint64_t expect, double fpp);
+
+/*
+ * @Description : New a split block bloom filter (BF_MAGIC_SPLIT_BLOCK).
+ *                A key sets one bit in each of the 8 lanes of one 256
+ *                bit block, so put and check are a few AVX2 instructions
+ *                with no branch per bit. CPUs without AVX2 get the
+ *                scalar loops, picked at runtime.
+ * @Date        : 2026-10-17
+ * @Author      : Xiangqian5
+ * @Software    : Weibo Inc.
+ *
+ * @param:
+ *  expect      : number of bloom elements.
+ *  fpp         : positive percent.
+ *
+ * @return:
+ *  bf          : pointer of bloom filter.
+ */
+
+BloomFilter *NewSplitBlockBF(uint64_t expect, double fpp);
+
+/*
+ * @Description : Create a writable bloom filter in shared memory. The
+ *                mapping holds everything the processes share: a
+ *                BitSetFileHeader, the bit_count stripes and the longs,
+ *                with no pointers, so it can be mapped at any address.
+ *                Puts OR words atomically as in concurrent mode, and every
+ *                process sees the others' puts at once. Create it before
+ *                forking the workers, or pass a memfd that other processes
+ *                map with AttachSharedBF.
+ * @Date        : 2026-10-17
+ * @Author      : Xiangqian5
+ * @Software    : Weibo Inc.
+ *
+ * @param:
+ *  expect      : Expected insertions.
+ *  fpp         : The desired false positive probability.
+ *  magic       : BF_MAGIC_*, the index strategy.
+ *  fd          : -1->anonymous mapping. Otherwise an empty file, e.g. a
+ *                memfd, sized and mapped.
+ *
+ * @return:
+ *  bloomfilter : The shared bloom filter. NULL->fail or fd not empty.
+ */
+
+BloomFilter *NewSharedBF(uint64_t expect, double fpp, int8_t magic, int fd);
+
+/*
+ * @Description : Map the shared bloom filter NewSharedBF created in fd.
+ * @Date        : 2026-10-17
+ * @Author      : Xiangqian5
+ * @Software    : Weibo Inc.
+ *
+ * @param:
+ *  fd          : The file passed to NewSharedBF.
+ *
+ * @return:
+ *  bloomfilter : The shared bloom filter. NULL->invalid file.
+ */
+
+BloomFilter *AttachSharedBF(int fd);
+
+/*
+ * @Description : Switch the put mode of an owned bloom filter.
+ *                By default a filter has a single writer: puts OR plain
+ *                words and count into bit_count, with no atomics.
+ *                In concurrent mode any number of threads may put and
+ *                check at once: each long is set with an atomic fetch_or,
+ *                so no bit is lost, and exactly the thread that sets a
+ *                bit counts it, into a per thread cache line stripe.
+ *                Switch before the filter is shared, and back only once
+ *                all writers are done; bit_count then takes the stripes.
+ *                Read BitCountBF rather than bit_count in between.
+ * @Date        : 2026-10-17
+ * @Author      : Xiangqian5
+ * @Software    : Weibo Inc.
+ *
+ * @param:
+ *  bf          : The bloom filter.
+ *  concurrent  : 1->concurrent. 0->single writer.
+ *
+ * @return:
+ *  ok          : 0->fail. 1->ok.
+ */
+
+int SetConcurrentBF(BloomFilter *bf, int concurrent);
+
+/*
+ * @Description : Start tracking the longs puts change, for SerializeDelta.
+ *                Every put that changes a long marks its cache line in a
+ *                dirty bitmap, 1 bit per BF_DIRTY_WORDS longs. All lines
+ *                start dirty, so the first delta overwrites the whole
+ *                filter of the receiver.
+ * @Date        : 2026-10-17
+ * @Author      : Xiangqian5
+ * @Software    : Weibo Inc.
+ *
+ * @param:
+ *  bf          : An owned bloom filter.
+ *
+ * @return:
+ *  ok          : 0->fail. 1->ok.
+ */
+
+int EnableDirtyBF(BloomFilter *bf);
+
+/*
+ * @Description : Bytes SerializeDelta needs for the lines dirty now.
+ * @Date        : 2026-10-17
+ * @Author      : Xiangqian5
+ * @Software    : Weibo Inc.
+ *
+ * @param:
+ *  bf          : A bloom filter tracking dirty lines.
+ *
+ * @return:
+ *  size        : Upper bound of the delta size. 0->not tracking.
+ */
+
+size_t DeltaSizeBF(BloomFilter *bf);
+
+/*
+ * @Description : Write the lines changed since the last delta, merged into
+ *                ranges of big endian longs, and clear their marks. Lines
+ *                only puts changed go as BF_DELTA_OR ranges, lines that
+ *                may have lost bits, to a ReplaceBitsetBF, an IntersectBF
+ *                or an overwrite range applied, as BF_DELTA_OVERWRITE
+ *                ones. A buf too small for every dirty line takes the
+ *                lines that fit, the rest stays dirty for the next delta,
+ *                and so do lines puts change while it runs.
+ * @Date        : 2026-10-17
+ * @Author      : Xiangqian5
+ * @Software    : Weibo Inc.
+ *
+ * @param:
+ *  bf          : A bloom filter tracking dirty lines.
+ *  buf         : Output buffer, receives the delta.
+ *  buf_len     : Length of buf, DeltaSizeBF(bf) holds every dirty line.
+ *
+ * @return:
+ *  size        : Bytes written, BF_DELTA_HEADER_LEN->nothing changed.
+ *                0->fail.
+ */
+
+size_t SerializeDelta(BloomFilter *bf, uint8_t *buf, size_t buf_len);
+
+/*
+ * @Description : Merge a delta of SerializeDelta into a bloom filter of the
+ *                same magic, hash_num and length. The longs of an OR range
+ *                are ORed in, those of an overwrite range replace the
+ *                receiver's, its own puts to those lines included, so a
+ *                replica ends up equal to the sender.
+ * @Date        : 2026-10-17
+ * @Author      : Xiangqian5
+ * @Software    : Weibo Inc.
+ *
+ * @param:
+ *  bf          : The owned or shared bloom filter to update.
+ *  buf         : The delta.
+ *  buf_len     : Length of the delta.
+ *
+ * @return:
+ *  ok          : 0->invalid delta or filter, nothing applied. 1->ok.
+ */
+
+int ApplyDelta(BloomFilter *bf, const uint8_t *buf, size_t buf_len);
+
+/*
+ * @Description : Swap the bitset of a live bloom filter for the one of
+ *                src, e.g. reloaded from redis with LoadBF, without
+ *                stalling its readers. Checks and puts of a concurrent
+ *                filter announce themselves in per stripe reader counters,
+ *                tagged with the epoch they entered in, and never block or
+ *                lock. The replace publishes the new longs, flips the epoch
+ *                and waits for the readers of the old epoch to leave
+ *                before it frees the old bitset. A check racing the
+ *                replace sees the old bits or the new ones; the bit count
+ *                is src's plus the puts after it, off only by puts in
+ *                flight on the old bits while it drains. A single
+ *                writer filter just swaps, with no reader left to wait for.
+ *                A filter tracking dirty lines marks all of them to be
+ *                overwritten: the next SerializeDelta is the whole filter,
+ *                and ApplyDelta turns replicas into the new bits, old keys
+ *                gone.
+ * @Date        : 2026-10-17
+ * @Author      : Xiangqian5
+ * @Software    : Weibo Inc.
+ *
+ * @param:
+ *  bf          : The owned bloom filter in use.
+ *  src         : An owned bloom filter of the same magic, hash_num and
+ *                length. It is destroyed on success.
+ *
+ * @return:
+ *  ok          : 0->fail, src untouched. 1->ok.
+ */
+
+int ReplaceBitsetBF(BloomFilter *bf, BloomFilter *src);
+
+/*
+ * @Description : Number of set bits, summing the concurrent stripes.
+ * @Date        : 2026-10-17
+ * @Author      : Xiangqian5
+ * @Software    : Weibo Inc.
+ *
+ * @param:
+ *  bf          : The bloom filter.
+ *
+ * @return:
+ *  bit_count   : Set bits.
+ */
+
+uint64_t BitCountBF(BloomFilter *bf);
+
 /*
  * @Description : Destroy a bloom filter.
  * @Date        : 2020-05-15
@@ -242,7 +697,9 @@ BloomFilter *NewBF(uint64_t expect, double fpp);
 void DestroyBF(BloomFilter *bf);
 
 /*
- * @Description : Serialize bloom data.
+ * @Description : Serialize bloom data in place, the bitset is left
+ *                big endian and bf must be reloaded before reuse.
+ *                See SerializeInto.
  * @Date        : 2020-05-15
  * @Author      : Xiangqian5
  * @Software    : Weibo Inc.
@@ -256,6 +713,62 @@ void DestroyBF(BloomFilter *bf);
 
 uint8_t * Serialized(BloomFilter *bf);
 
+/*
+ * @Description : Size of the serialized bloom data.
+ * @Date        : 2026-10-17
+ * @Author      : Xiangqian5
+ * @Software    : Weibo Inc.
+ *
+ * @param:
+ *  bf          : The bloom filter to storage.
+ *
+ * @return:
+ *  size        : Bytes needed by SerializeInto. 0->bf is invalid.
+ */
+
+size_t SerializedSize(BloomFilter *bf);
+
+/*
+ * @Description : Serialize bloom data into a caller-owned buffer.
+ *                Unlike Serialized, the live bitset is left untouched,
+ *                so the filter keeps serving queries afterwards.
+ * @Date        : 2026-10-17
+ * @Author      : Xiangqian5
+ * @Software    : Weibo Inc.
+ *
+ * @param:
+ *  bf          : The bloom filter to storage.
+ *  buf         : Output buffer, receives the big endian byte array.
+ *  buf_len     : Length of buf, at least SerializedSize(bf).
+ *
+ * @return:
+ *  size        : Bytes written. 0->fail.
+ */
+
+size_t SerializeInto(BloomFilter *bf, uint8_t *buf, size_t buf_len);
+
+/*
+ * @Description : Serialize a bloom filter to whichever is smaller: the
+ *                guava format of SerializeInto, or a sparse format for
+ *                young filters, BF_SPARSE_MAGIC then the gaps between set
+ *                bits as varints. Dense filters (a set bit per byte or
+ *                more) go raw without trying. LoadBF reads both, guava
+ *                only the raw one.
+ * @Date        : 2026-10-17
+ * @Author      : Xiangqian5
+ * @Software    : Weibo Inc.
+ *
+ * @param:
+ *  bf          : The bloom filter to storage.
+ *  buf         : Output buffer.
+ *  buf_len     : Length of buf, at least SerializedSize(bf).
+ *
+ * @return:
+ *  size        : Bytes written. 0->fail.
+ */
+
+size_t SerializeCompact(BloomFilter *bf, uint8_t *buf, size_t buf_len);
+
 /*
  * @Description : Check element is in the bloom or not.
  * @Date        : 2020-05-15
@@ -272,6 +785,25 @@ uint8_t * Serialized(BloomFilter *bf);
 
 int MightContainStrNumber(BloomFilter *bf, StrNumber sn);
 
+/*
+ * @Description : Check a decimal string element is in the bloom or not,
+ *                same answer as MightContainStrNumber. The string needs
+ *                no NUL and no StrNumber copy, e.g. a lua string.
+ * @Date        : 2026-10-17
+ * @Author      : Xiangqian5
+ * @Software    : Weibo Inc.
+ *
+ * @param
+ *  bf          : The bloom filter .
+ *  str         : The element to check, parsed as atoll.
+ *  len         : Bytes of str.
+ *
+ * @return
+ *  is_in       : 0->not in. 1->in.
+ */
+
+int MightContainStrNumberLen(BloomFilter *bf, const char *str, size_t len);
+
 /*
  * @Description : Check number element is in the bloom or not.
  * @Date        : 2020-05-15
@@ -320,4 +852,255 @@ int PutStrNumber(BloomFilter *bf, StrNumber sn);
 
 int PutUint64(BloomFilter *bf, double sn);
 
+/*
+ * @Description : Put a byte string element into bloom, hashed in place.
+ *                Same bits as guava Funnels.byteArrayFunnel(), and as
+ *                Funnels.stringFunnel(UTF_8) when key holds UTF-8.
+ * @Date        : 2026-10-17
+ * @Author      : Xiangqian5
+ * @Software    : Weibo Inc.
+ *
+ * @param:
+ *  bf          : The bloom filter .
+ *  key         : The element to put.
+ *  len         : Length of key in bytes.
+ *
+ * @return:
+ *  ok          : 0->fail or no bit changed. 1->ok.
+ */
+
+int PutBytes(BloomFilter *bf, const void *key, size_t len);
+
+/*
+ * @Description : Check byte string element is in the bloom or not,
+ *                hashed like PutBytes.
+ * @Date        : 2026-10-17
+ * @Author      : Xiangqian5
+ * @Software    : Weibo Inc.
+ *
+ * @param
+ *  bf          : The bloom filter .
+ *  key         : The element to check.
+ *  len         : Length of key in bytes.
+ *
+ * @return
+ *  is_in       : 0->not in. 1->in.
+ */
+
+int MightContainBytes(BloomFilter *bf, const void *key, size_t len);
+
+/*
+ * @Description : Put a 32 bit integer element into bloom, as guava
+ *                Funnels.integerFunnel().
+ * @Date        : 2026-10-17
+ * @Author      : Xiangqian5
+ * @Software    : Weibo Inc.
+ *
+ * @param:
+ *  bf          : The bloom filter .
+ *  sn          : The element to put.
+ *
+ * @return:
+ *  ok          : 0->fail or no bit changed. 1->ok.
+ */
+
+int PutInt32(BloomFilter *bf, int32_t sn);
+
+/*
+ * @Description : Check 32 bit integer element is in the bloom or not,
+ *                hashed like PutInt32.
+ * @Date        : 2026-10-17
+ * @Author      : Xiangqian5
+ * @Software    : Weibo Inc.
+ *
+ * @param
+ *  bf          : The bloom filter .
+ *  sn          : The element to check.
+ *
+ * @return
+ *  is_in       : 0->not in. 1->in.
+ */
+
+int MightContainInt32(BloomFilter *bf, int32_t sn);
+
+/*
+ * @Description : Check a batch of number elements. Keys are hashed a
+ *                group at a time and the words they probe prefetched,
+ *                so the cache misses of a group overlap.
+ * @Date        : 2026-10-17
+ * @Author      : Xiangqian5
+ * @Software    : Weibo Inc.
+ *
+ * @param
+ *  bf          : The bloom filter .
+ *  keys        : The elements to check.
+ *  n           : Number of keys.
+ *  out         : n results, 0->not in. 1->in.
+ *
+ * @return
+ *  hits        : Number of keys that might be in. 0->none or fail.
+ */
+
+size_t MightContainNumberBatch(BloomFilter *bf, const uint64_t *keys, size_t n, uint8_t *out);
+
+/*
+ * @Description : Put a batch of number elements into bloom, prefetching
+ *                like MightContainNumberBatch.
+ * @Date        : 2026-10-17
+ * @Author      : Xiangqian5
+ * @Software    : Weibo Inc.
+ *
+ * @param:
+ *  bf          : The bloom filter .
+ *  keys        : The elements to put.
+ *  n           : Number of keys.
+ *
+ * @return:
+ *  changed     : Number of keys that changed bits. 0->none or fail.
+ */
+
+size_t PutUint64Batch(BloomFilter *bf, const uint64_t *keys, size_t n);
+
+/*
+ * @Description : Build a guava bloom filter from a key array on several
+ *                threads. Keys are hashed in parallel and their bit indexes
+ *                radix partitioned by word range, each thread owning one
+ *                range, so bits are set without atomics. The result is byte
+ *                identical to NewBF + PutUint64 of every key.
+ * @Date        : 2026-10-17
+ * @Author      : Xiangqian5
+ * @Software    : Weibo Inc.
+ *
+ * @param:
+ *  keys        : The elements to put.
+ *  n           : Number of keys, also the expected insertions.
+ *  fpp         : The desired false positive probability.
+ *  threads     : Worker threads, the caller being one. <=0->online cpus.
+ *
+ * @return:
+ *  bloomfilter : The new bloom filter. NULL->fail.
+ */
+
+BloomFilter *BuildBF(const uint64_t *keys, size_t n, double fpp, int threads);
+
+/*
+ * @Description : Merge src into dst: dst |= src, the filter of both key
+ *                sets. src may be a ViewBF of a Serialized blob, e.g. from
+ *                redis, swapped on the fly without a LoadBF. bit_count of
+ *                dst follows from the bits that changed.
+ * @Date        : 2026-10-17
+ * @Author      : Xiangqian5
+ * @Software    : Weibo Inc.
+ *
+ * @param:
+ *  dst         : The bloom filter to merge into, owned or shared.
+ *  src         : The bloom filter to merge, any mode.
+ *
+ * @return:
+ *  ok          : 1->merged. 0->magic, hash_num or length differ, or dst
+ *                is read only.
+ */
+
+int UnionBF(BloomFilter *dst, BloomFilter *src);
+
+/*
+ * @Description : dst &= src. Not the filter of the common keys, which may
+ *                have fewer bits, but holds them all at no more fpp than
+ *                dst had. The lines it clears bits of go to the next
+ *                SerializeDelta as overwrite ranges, so replicas lose the
+ *                bits too. As UnionBF otherwise.
+ * @Date        : 2026-10-17
+ * @Author      : Xiangqian5
+ * @Software    : Weibo Inc.
+ *
+ * @param:
+ *  dst         : The bloom filter to intersect into, owned or shared.
+ *  src         : The bloom filter to intersect with, any mode.
+ *
+ * @return:
+ *  ok          : 1->intersected. 0->the filters differ, or dst is read only.
+ */
+
+int IntersectBF(BloomFilter *dst, BloomFilter *src);
+
+/*
+ * @Description : Estimate the jaccard similarity of the key sets of a and b
+ *                from the bits set in a, b and a | b (Swamidass-Baldi), in
+ *                one pass over both. Either may be a ViewBF.
+ * @Date        : 2026-10-17
+ * @Author      : Xiangqian5
+ * @Software    : Weibo Inc.
+ *
+ * @param:
+ *  a           : A bloom filter.
+ *  b           : A bloom filter of the same magic, hash_num and length.
+ *
+ * @return:
+ *  jaccard     : 0 to 1. -1->the filters differ.
+ */
+
+double JaccardEstimateBF(BloomFilter *a, BloomFilter *b);
+
+/*
+ * @Description : Estimate the keys put so far from the bits set
+ *                (Swamidass-Baldi): -(m / k) * ln(1 - X / m). O(1) from
+ *                the maintained bit count, exact under SetConcurrentBF and
+ *                shared filters too; a ViewBF keeps no count, so it is
+ *                counted each call. Close for the blocked magics, within a
+ *                few percent, exact in expectation for the others.
+ * @Date        : 2026-10-17
+ * @Author      : Xiangqian5
+ * @Software    : Weibo Inc.
+ *
+ * @param:
+ *  bf          : The bloom filter.
+ *
+ * @return:
+ *  count       : Estimated keys, inf when all bits are set. -1->no bits to
+ *                count by, a fuse filter.
+ */
+
+double EstimateCountBF(BloomFilter *bf);
+
+/*
+ * @Description : The fpp a lookup of a new key has now, (X / m)^k of the
+ *                bits set, to tell a saturated filter from its sizing.
+ *                A lower bound for the blocked magics: their blocks fill
+ *                unevenly, see blockedFpp.
+ * @Date        : 2026-10-17
+ * @Author      : Xiangqian5
+ * @Software    : Weibo Inc.
+ *
+ * @param:
+ *  bf          : The bloom filter.
+ *
+ * @return:
+ *  fpp         : 0 to 1. -1->a fuse filter.
+ */
+
+double CurrentFppBF(BloomFilter *bf);
+
+/*
+ * @Description : Build a binary fuse filter (Graf and Lemire) of keys, for
+ *                sets built once and then only queried. An 8 bit
+ *                fingerprint a key, about 9 bits per key at fpp 0.39%,
+ *                and a lookup reads exactly 3 bytes. It is a BloomFilter
+ *                of BF_MAGIC_FUSE: MightContainNumber and the batch, the
+ *                Serialized/LoadBF/ViewBF/WriteBFFile paths take it, the
+ *                puts refuse it. The keys hash as PutUint64 hashes them.
+ * @Date        : 2026-10-17
+ * @Author      : Xiangqian5
+ * @Software    : Weibo Inc.
+ *
+ * @param:
+ *  keys        : The numbers, duplicates allowed.
+ *  n           : Number of keys.
+ *
+ * @return:
+ *  bf          : The fuse filter. NULL->out of memory, or no seed of
+ *                BF_FUSE_MAX_ITERATIONS built it.
+ */
+
+BloomFilter *BuildFuseBF(const uint64_t *keys, size_t n);
+
 #endif //BLOOMFILTER_BLOOMFILTER_H
@@ -0,0 +1,275 @@
+/*
+BSD 3-Clause License
+
+Copyright (c) 2020, _Xiangqian
+        All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+        this list of conditions and the following disclaimer in the documentation
+and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+contributors may be used to endorse or promote products derived from
+        this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+        IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+        FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+        CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define _DEFAULT_SOURCE
+
+#include "countingbf.h"
+
+#define BF_ALWAYS_INLINE    static inline __attribute__((always_inline))
+
+#define BF_COUNTING_ALIGN   64
+
+//the guava probes of NewBF, over counters instead of bits.
+BF_ALWAYS_INLINE void counterIndexes(const CountingBF *cbf, double sn, uint64_t *probes)
+{
+    uint64_t counters   = (uint64_t)cbf->length * BF_COUNTING_PER_WORD;
+    uint64_t out[2]     = {0};
+    uint64_t combine    = 0;
+
+    MurmurHash3_x64_128_u64((uint64_t)sn, cbf->seed, out);
+    combine = *out;
+
+    for (int i = 0; i < cbf->hash_num; i++) {
+        *(probes + i) = (combine & INT64_MAX) % counters;
+        combine += *(out + 1);
+    }
+}
+
+BF_ALWAYS_INLINE uint64_t counterGet(const uint64_t *data, uint64_t index)
+{
+    return (*(data + index / BF_COUNTING_PER_WORD) >> (index % BF_COUNTING_PER_WORD * BF_COUNTING_BITS))
+        & BF_COUNTING_MAX;
+}
+
+//+1 unless saturated, no branch.
+BF_ALWAYS_INLINE void counterInc(uint64_t *data, uint64_t index)
+{
+    uint64_t *word  = data + index / BF_COUNTING_PER_WORD;
+    int shift       = index % BF_COUNTING_PER_WORD * BF_COUNTING_BITS;
+    uint64_t count  = (*word >> shift) & BF_COUNTING_MAX;
+
+    *word += (uint64_t)(count != BF_COUNTING_MAX) << shift;
+}
+
+//-1 unless zero or saturated, a saturated one lost its true count.
+BF_ALWAYS_INLINE void counterDec(uint64_t *data, uint64_t index)
+{
+    uint64_t *word  = data + index / BF_COUNTING_PER_WORD;
+    int shift       = index % BF_COUNTING_PER_WORD * BF_COUNTING_BITS;
+    uint64_t count  = (*word >> shift) & BF_COUNTING_MAX;
+
+    *word -= (uint64_t)(count - 1 < BF_COUNTING_MAX - 1) << shift;
+}
+
+static CountingBF *allocCBF(uint8_t hash_num, uint32_t length)
+{
+    CountingBF *cbf = NULL;
+    void *data      = NULL;
+
+    if (posix_memalign(&data, BF_COUNTING_ALIGN, sizeof(uint64_t) * (size_t)length) != 0) {
+        return NULL;
+    }
+
+    cbf = (CountingBF *)calloc(1, sizeof(CountingBF));
+    if (NULL == cbf) {
+        free(data);
+        return NULL;
+    }
+
+    memset(data, 0, sizeof(uint64_t) * (size_t)length);
+
+    cbf->seed = 0;
+    cbf->hash_num = hash_num;
+    cbf->length = length;
+    cbf->data = (uint64_t *)data;
+
+    return cbf;
+}
+
+CountingBF *NewCBF(uint64_t expect, double fpp)
+{
+    uint64_t counters   = 0;
+    uint64_t length     = 0;
+    int hash_num        = 0;
+
+    if (expect == 0) {
+        expect = 1;
+    }
+
+    counters = OptimalNumOfBits(expect, fpp);
+    hash_num = OptimalNumOfHash(expect, counters);
+    length = (counters + BF_COUNTING_PER_WORD - 1) / BF_COUNTING_PER_WORD;
+
+    if (length == 0) {
+        length = 1;
+    }
+
+    if (length > UINT32_MAX || hash_num > UINT8_MAX) {
+        return NULL;
+    }
+
+    return allocCBF((uint8_t)hash_num, (uint32_t)length);
+}
+
+int PutUint64CBF(CountingBF *cbf, double sn)
+{
+    uint64_t probes[UINT8_MAX];
+    int changed         = 0;
+
+    if (NULL == cbf) {
+        return 0;
+    }
+
+    counterIndexes(cbf, sn, probes);
+
+    for (int i = 0; i < cbf->hash_num; i++) {
+        changed |= counterGet(cbf->data, *(probes + i)) == 0;
+        counterInc(cbf->data, *(probes + i));
+    }
+
+    return changed;
+}
+
+int RemoveUint64CBF(CountingBF *cbf, double sn)
+{
+    uint64_t probes[UINT8_MAX];
+    uint64_t is_in      = 1;
+
+    if (NULL == cbf) {
+        return 0;
+    }
+
+    counterIndexes(cbf, sn, probes);
+
+    for (int i = 0; i < cbf->hash_num; i++) {
+        is_in &= counterGet(cbf->data, *(probes + i)) != 0;
+    }
+
+    if (!is_in) {
+        return 0;
+    }
+
+    for (int i = 0; i < cbf->hash_num; i++) {
+        counterDec(cbf->data, *(probes + i));
+    }
+
+    return 1;
+}
+
+int MightContainNumberCBF(CountingBF *cbf, double sn)
+{
+    uint64_t counters   = 0;
+    uint64_t out[2]     = {0};
+    uint64_t combine    = 0;
+
+    if (NULL == cbf) {
+        return 0;
+    }
+
+    //probe as they are made, most keys miss on the first ones.
+    counters = (uint64_t)cbf->length * BF_COUNTING_PER_WORD;
+    MurmurHash3_x64_128_u64((uint64_t)sn, cbf->seed, out);
+    combine = *out;
+
+    for (int i = 0; i < cbf->hash_num; i++) {
+        if (counterGet(cbf->data, (combine & INT64_MAX) % counters) == 0) {
+            return 0;
+        }
+        combine += *(out + 1);
+    }
+
+    return 1;
+}
+
+size_t SerializedSizeCBF(CountingBF *cbf)
+{
+    if (NULL == cbf) {
+        return 0;
+    }
+
+    return HEADER_LEN + (size_t)cbf->length * sizeof(uint64_t);
+}
+
+size_t SerializeIntoCBF(CountingBF *cbf, uint8_t *buf, size_t buf_len)
+{
+    uint32_t be_length  = 0;
+    size_t size         = SerializedSizeCBF(cbf);
+
+    if (size == 0 || NULL == buf || buf_len < size) {
+        return 0;
+    }
+
+    be_length = BF_HTONL(cbf->length);
+
+    *buf = BF_MAGIC_COUNTING;
+    *(buf + 1) = cbf->hash_num;
+    memcpy(buf + 2, &be_length, sizeof(uint32_t));
+
+    for (uint32_t i = 0; i < cbf->length; i++) {
+        uint64_t word = BF_HTONLL(*(cbf->data + i));
+
+        memcpy(buf + HEADER_LEN + (size_t)i * sizeof(uint64_t), &word, sizeof(uint64_t));
+    }
+
+    return size;
+}
+
+CountingBF *LoadCBF(const void *byte_array, size_t array_len)
+{
+    const uint8_t *buf  = (const uint8_t *)byte_array;
+    CountingBF *cbf     = NULL;
+    uint32_t length     = 0;
+
+    if (NULL == buf || array_len < HEADER_LEN || (int8_t)*buf != BF_MAGIC_COUNTING || *(buf + 1) == 0) {
+        return NULL;
+    }
+
+    memcpy(&length, buf + 2, sizeof(uint32_t));
+    length = BF_NTOHL(length);
+    if (length == 0 || array_len != HEADER_LEN + (size_t)length * sizeof(uint64_t)) {
+        return NULL;
+    }
+
+    cbf = allocCBF(*(buf + 1), length);
+    if (NULL == cbf) {
+        return NULL;
+    }
+
+    for (uint32_t i = 0; i < length; i++) {
+        uint64_t word = 0;
+
+        memcpy(&word, buf + HEADER_LEN + (size_t)i * sizeof(uint64_t), sizeof(uint64_t));
+        *(cbf->data + i) = BF_NTOHLL(word);
+    }
+
+    return cbf;
+}
+
+void DestroyCBF(CountingBF *cbf)
+{
+    if (NULL == cbf) {
+        return;
+    }
+
+    free(cbf->data);
+    free(cbf);
+}
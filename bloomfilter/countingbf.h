@@ -0,0 +1,188 @@
+/*
+BSD 3-Clause License
+
+Copyright (c) 2020, _Xiangqian
+        All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+        this list of conditions and the following disclaimer in the documentation
+and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+contributors may be used to endorse or promote products derived from
+        this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+        IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+        FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+        CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef BLOOMFILTER_COUNTINGBF_H
+#define BLOOMFILTER_COUNTINGBF_H
+
+#include "bloomfilter.h"
+
+//4 bit counters, 16 to a long. A counter stuck at 15 is never decremented.
+#define BF_COUNTING_BITS    4
+#define BF_COUNTING_PER_WORD    (64 / BF_COUNTING_BITS)
+#define BF_COUNTING_MAX     ((1 << BF_COUNTING_BITS) - 1)
+
+typedef struct {
+    //seed
+    uint32_t seed;
+
+    //Number of hash functions.
+    uint8_t hash_num;
+
+    //longs of counters, BF_COUNTING_PER_WORD each.
+    uint32_t length;
+
+    //host order longs, 64 byte aligned.
+    uint64_t *data;
+} CountingBF;
+
+/*
+ * @Description : New a counting bloom filter, one 4 bit counter where
+ *                NewBF has a bit, so keys can be removed again. Probes are
+ *                the guava ones of NewBF over the counters. 4x the memory
+ *                of NewBF. Not thread safe, one writer at a time.
+ * @Date        : 2026-10-17
+ * @Author      : Xiangqian5
+ * @Software    : Weibo Inc.
+ *
+ * @param:
+ *  expect      : The number of elements.
+ *  fpp         : The rate of false positive.
+ *
+ * @return:
+ *  cbf         : The counting bloom filter. NULL->out of memory.
+ */
+
+CountingBF *NewCBF(uint64_t expect, double fpp);
+
+/*
+ * @Description : Put a number into the counting bloom filter.
+ * @Date        : 2026-10-17
+ * @Author      : Xiangqian5
+ * @Software    : Weibo Inc.
+ *
+ * @param:
+ *  cbf         : The counting bloom filter.
+ *  sn          : The number, hashed as PutUint64 does.
+ *
+ * @return:
+ *  changed     : 1->a counter left zero. 0->it might have been in.
+ */
+
+int PutUint64CBF(CountingBF *cbf, double sn);
+
+/*
+ * @Description : Remove a number put before. A number never put must not
+ *                be removed: if it is a false positive, the counters of
+ *                other numbers drop.
+ * @Date        : 2026-10-17
+ * @Author      : Xiangqian5
+ * @Software    : Weibo Inc.
+ *
+ * @param:
+ *  cbf         : The counting bloom filter.
+ *  sn          : The number.
+ *
+ * @return:
+ *  removed     : 1->removed. 0->not in, nothing changed.
+ */
+
+int RemoveUint64CBF(CountingBF *cbf, double sn);
+
+/*
+ * @Description : Check a number is in the counting bloom filter or not.
+ * @Date        : 2026-10-17
+ * @Author      : Xiangqian5
+ * @Software    : Weibo Inc.
+ *
+ * @param:
+ *  cbf         : The counting bloom filter.
+ *  sn          : The number.
+ *
+ * @return:
+ *  is_in       : 0->not in. 1->in.
+ */
+
+int MightContainNumberCBF(CountingBF *cbf, double sn);
+
+/*
+ * @Description : Bytes SerializeIntoCBF writes: the layout of Serialized,
+ *                BF_MAGIC_COUNTING then hash_num, the BE length and the BE
+ *                longs of counters.
+ * @Date        : 2026-10-17
+ * @Author      : Xiangqian5
+ * @Software    : Weibo Inc.
+ *
+ * @param:
+ *  cbf         : The counting bloom filter.
+ *
+ * @return:
+ *  size        : Bytes. 0->cbf is NULL.
+ */
+
+size_t SerializedSizeCBF(CountingBF *cbf);
+
+/*
+ * @Description : Serialize a counting bloom filter into buf.
+ * @Date        : 2026-10-17
+ * @Author      : Xiangqian5
+ * @Software    : Weibo Inc.
+ *
+ * @param:
+ *  cbf         : The counting bloom filter.
+ *  buf         : Output buffer.
+ *  buf_len     : Length of buf, at least SerializedSizeCBF(cbf).
+ *
+ * @return:
+ *  size        : Bytes written. 0->fail.
+ */
+
+size_t SerializeIntoCBF(CountingBF *cbf, uint8_t *buf, size_t buf_len);
+
+/*
+ * @Description : Load a counting bloom filter from SerializeIntoCBF bytes.
+ * @Date        : 2026-10-17
+ * @Author      : Xiangqian5
+ * @Software    : Weibo Inc.
+ *
+ * @param:
+ *  byte_array  : byte array.
+ *  array_len   : length of byte array.
+ *
+ * @return:
+ *  cbf         : The counting bloom filter. NULL->invalid byte array.
+ */
+
+CountingBF *LoadCBF(const void *byte_array, size_t array_len);
+
+/*
+ * @Description : Free a counting bloom filter.
+ * @Date        : 2026-10-17
+ * @Author      : Xiangqian5
+ * @Software    : Weibo Inc.
+ *
+ * @param:
+ *  cbf         : The counting bloom filter.
+ */
+
+void DestroyCBF(CountingBF *cbf);
+
+#endif //BLOOMFILTER_COUNTINGBF_H
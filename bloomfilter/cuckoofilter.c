@@ -0,0 +1,404 @@
+/*
+BSD 3-Clause License
+
+Copyright (c) 2020, _Xiangqian
+        All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+        this list of conditions and the following disclaimer in the documentation
+and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+contributors may be used to endorse or promote products derived from
+        this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+        IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+        FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+        CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define _DEFAULT_SOURCE
+
+#include <endian.h>
+#include "cuckoofilter.h"
+
+#define BF_ALWAYS_INLINE    static inline __attribute__((always_inline))
+
+//lowest and highest bit of each fingerprint of a bucket.
+#define BF_CUCKOO_LANE_LOW  0x001001001001ULL
+#define BF_CUCKOO_LANE_HIGH 0x800800800800ULL
+#define BF_CUCKOO_FP_MASK   ((1ULL << BF_CUCKOO_FP_BITS) - 1)
+#define BF_CUCKOO_BUCKET_MASK   ((1ULL << (BF_CUCKOO_FP_BITS * BF_CUCKOO_SLOTS)) - 1)
+
+//lines holding buckets.
+BF_ALWAYS_INLINE size_t lineCount(uint32_t buckets)
+{
+    return ((size_t)buckets + BF_CUCKOO_LINE_BUCKETS - 1) / BF_CUCKOO_LINE_BUCKETS;
+}
+
+//bucket i in its line, the last one ends 2 bytes before the padding so a
+//long load of any bucket stays in one line.
+BF_ALWAYS_INLINE uint8_t *bucketAt(const CuckooFilter *cf, uint32_t i)
+{
+    return cf->data + (size_t)(i / BF_CUCKOO_LINE_BUCKETS) * BF_CUCKOO_LINE_BYTES
+           + (i % BF_CUCKOO_LINE_BUCKETS) * BF_CUCKOO_BUCKET_BYTES;
+}
+
+//bytes of the buckets in the line starting at bucket i, short for the last.
+BF_ALWAYS_INLINE size_t lineBytes(uint32_t buckets, uint32_t i)
+{
+    uint32_t n = buckets - i;
+
+    return (size_t)(n < BF_CUCKOO_LINE_BUCKETS ? n : BF_CUCKOO_LINE_BUCKETS) * BF_CUCKOO_BUCKET_BYTES;
+}
+
+//the 6 bytes of bucket i, the 2 after it masked off.
+BF_ALWAYS_INLINE uint64_t bucketLoad(const CuckooFilter *cf, uint32_t i)
+{
+    uint64_t bucket = 0;
+
+    memcpy(&bucket, bucketAt(cf, i), sizeof(uint64_t));
+
+    return le64toh(bucket) & BF_CUCKOO_BUCKET_MASK;
+}
+
+BF_ALWAYS_INLINE void bucketStore(CuckooFilter *cf, uint32_t i, uint64_t bucket)
+{
+    bucket = htole64(bucket);
+    memcpy(bucketAt(cf, i), &bucket, BF_CUCKOO_BUCKET_BYTES);
+}
+
+BF_ALWAYS_INLINE uint64_t slotGet(uint64_t bucket, int slot)
+{
+    return (bucket >> (slot * BF_CUCKOO_FP_BITS)) & BF_CUCKOO_FP_MASK;
+}
+
+BF_ALWAYS_INLINE uint64_t slotSet(uint64_t bucket, int slot, uint64_t fp)
+{
+    int shift = slot * BF_CUCKOO_FP_BITS;
+
+    return (bucket & ~(BF_CUCKOO_FP_MASK << shift)) | (fp << shift);
+}
+
+//all 4 slots compared at once: a lane of bucket ^ fp is zero where it matches.
+BF_ALWAYS_INLINE int bucketHas(uint64_t bucket, uint64_t fp)
+{
+    uint64_t x = bucket ^ (fp * BF_CUCKOO_LANE_LOW);
+
+    return ((x - BF_CUCKOO_LANE_LOW) & ~x & BF_CUCKOO_LANE_HIGH) != 0;
+}
+
+//the bucket and the non zero fingerprint of a key, from PutUint64's hash.
+BF_ALWAYS_INLINE void cuckooHash(const CuckooFilter *cf, double sn, uint32_t *bucket, uint64_t *fp)
+{
+    uint64_t out[2] = {0};
+
+    MurmurHash3_x64_128_u64((uint64_t)sn, cf->seed, out);
+
+    *bucket = (uint32_t)(((unsigned __int128)*out * cf->buckets) >> 64);
+    *fp = *(out + 1) >> (64 - BF_CUCKOO_FP_BITS);
+    *fp += *fp == 0;
+}
+
+//(h(fp) - i) mod buckets: its own inverse for any number of buckets.
+BF_ALWAYS_INLINE uint32_t altBucket(const CuckooFilter *cf, uint32_t i, uint64_t fp)
+{
+    uint64_t h = ((fp * 0x9e3779b97f4a7c15ULL) >> 32) % cf->buckets;
+
+    return (uint32_t)((h + cf->buckets - i) % cf->buckets);
+}
+
+BF_ALWAYS_INLINE uint64_t nextRandom(CuckooFilter *cf)
+{
+    cf->rng ^= cf->rng >> 12;
+    cf->rng ^= cf->rng << 25;
+    cf->rng ^= cf->rng >> 27;
+
+    return cf->rng * 0x2545f4914f6cdd1dULL;
+}
+
+//0->no empty slot in bucket i.
+static int slotPut(CuckooFilter *cf, uint32_t i, uint64_t fp)
+{
+    uint64_t bucket = bucketLoad(cf, i);
+
+    for (int slot = 0; slot < BF_CUCKOO_SLOTS; slot++) {
+        if (slotGet(bucket, slot) == 0) {
+            bucketStore(cf, i, slotSet(bucket, slot, fp));
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+//0->fp not in bucket i.
+static int slotRemove(CuckooFilter *cf, uint32_t i, uint64_t fp)
+{
+    uint64_t bucket = bucketLoad(cf, i);
+
+    for (int slot = 0; slot < BF_CUCKOO_SLOTS; slot++) {
+        if (slotGet(bucket, slot) == fp) {
+            bucketStore(cf, i, slotSet(bucket, slot, 0));
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+//place fp in bucket i or its alternate, evicting others to their alternates
+//if both are full. The last one evicted becomes the victim.
+static void cuckooInsert(CuckooFilter *cf, uint32_t i, uint64_t fp)
+{
+    if (slotPut(cf, i, fp)) {
+        return;
+    }
+
+    i = altBucket(cf, i, fp);
+    for (int kick = 0; kick < BF_CUCKOO_MAX_KICKS; kick++) {
+        uint64_t bucket = 0;
+        uint64_t evicted = 0;
+        int slot = 0;
+
+        if (slotPut(cf, i, fp)) {
+            return;
+        }
+
+        bucket = bucketLoad(cf, i);
+        slot = (int)(nextRandom(cf) % BF_CUCKOO_SLOTS);
+        evicted = slotGet(bucket, slot);
+        bucketStore(cf, i, slotSet(bucket, slot, fp));
+
+        fp = evicted;
+        i = altBucket(cf, i, fp);
+    }
+
+    cf->victim_used = 1;
+    cf->victim_bucket = i;
+    cf->victim_fp = (uint16_t)fp;
+}
+
+BF_ALWAYS_INLINE int victimIs(const CuckooFilter *cf, uint32_t i1, uint32_t i2, uint64_t fp)
+{
+    return cf->victim_used && cf->victim_fp == fp && (cf->victim_bucket == i1 || cf->victim_bucket == i2);
+}
+
+static CuckooFilter *allocCF(uint32_t buckets)
+{
+    CuckooFilter *cf    = NULL;
+    void *data          = NULL;
+    size_t size         = lineCount(buckets) * BF_CUCKOO_LINE_BYTES;
+
+    if (posix_memalign(&data, BF_CUCKOO_LINE_BYTES, size) != 0) {
+        return NULL;
+    }
+
+    cf = (CuckooFilter *)calloc(1, sizeof(CuckooFilter));
+    if (NULL == cf) {
+        free(data);
+        return NULL;
+    }
+
+    memset(data, 0, size);
+
+    cf->seed = 0;
+    cf->buckets = buckets;
+    cf->data = (uint8_t *)data;
+    cf->rng = 0x9e3779b97f4a7c15ULL;
+
+    return cf;
+}
+
+CuckooFilter *NewCF(uint64_t expect)
+{
+    uint64_t buckets = (uint64_t)ceil((double)expect / (BF_CUCKOO_SLOTS * BF_CUCKOO_LOAD));
+
+    //the padded lines are allocated anyway, fill them.
+    buckets = (buckets + BF_CUCKOO_LINE_BUCKETS - 1) / BF_CUCKOO_LINE_BUCKETS * BF_CUCKOO_LINE_BUCKETS;
+    if (buckets == 0) {
+        buckets = BF_CUCKOO_LINE_BUCKETS;
+    }
+
+    if (buckets > UINT32_MAX) {
+        return NULL;
+    }
+
+    return allocCF((uint32_t)buckets);
+}
+
+int PutUint64CF(CuckooFilter *cf, double sn)
+{
+    uint32_t i      = 0;
+    uint64_t fp     = 0;
+
+    if (NULL == cf || cf->victim_used) {
+        return 0;
+    }
+
+    cuckooHash(cf, sn, &i, &fp);
+    cuckooInsert(cf, i, fp);
+    cf->count++;
+
+    return 1;
+}
+
+int RemoveUint64CF(CuckooFilter *cf, double sn)
+{
+    uint32_t i1     = 0;
+    uint32_t i2     = 0;
+    uint64_t fp     = 0;
+
+    if (NULL == cf) {
+        return 0;
+    }
+
+    cuckooHash(cf, sn, &i1, &fp);
+    i2 = altBucket(cf, i1, fp);
+
+    if (victimIs(cf, i1, i2, fp)) {
+        cf->victim_used = 0;
+        cf->count--;
+        return 1;
+    }
+
+    if (!slotRemove(cf, i1, fp) && !slotRemove(cf, i2, fp)) {
+        return 0;
+    }
+
+    cf->count--;
+
+    //a slot is free now, give the victim another try.
+    if (cf->victim_used) {
+        cf->victim_used = 0;
+        cuckooInsert(cf, cf->victim_bucket, cf->victim_fp);
+    }
+
+    return 1;
+}
+
+int MightContainNumberCF(CuckooFilter *cf, double sn)
+{
+    uint32_t i1     = 0;
+    uint32_t i2     = 0;
+    uint64_t fp     = 0;
+
+    if (NULL == cf) {
+        return 0;
+    }
+
+    cuckooHash(cf, sn, &i1, &fp);
+    i2 = altBucket(cf, i1, fp);
+
+    return bucketHas(bucketLoad(cf, i1), fp) | bucketHas(bucketLoad(cf, i2), fp) | victimIs(cf, i1, i2, fp);
+}
+
+size_t SerializedSizeCF(CuckooFilter *cf)
+{
+    if (NULL == cf) {
+        return 0;
+    }
+
+    return BF_CUCKOO_HEADER_LEN + (size_t)cf->buckets * BF_CUCKOO_BUCKET_BYTES;
+}
+
+size_t SerializeIntoCF(CuckooFilter *cf, uint8_t *buf, size_t buf_len)
+{
+    size_t size         = SerializedSizeCF(cf);
+    uint32_t buckets    = 0;
+    uint64_t count      = 0;
+    uint32_t victim     = 0;
+
+    if (size == 0 || NULL == buf || buf_len < size) {
+        return 0;
+    }
+
+    buckets = BF_HTONL(cf->buckets);
+    count = BF_HTONLL(cf->count);
+    victim = BF_HTONL(cf->victim_bucket);
+    *buf = BF_MAGIC_CUCKOO;
+    *(buf + 1) = BF_CUCKOO_FP_BITS;
+    memcpy(buf + 2, &buckets, sizeof(uint32_t));
+    memcpy(buf + 6, &count, sizeof(uint64_t));
+    *(buf + 14) = cf->victim_used;
+    memcpy(buf + 15, &victim, sizeof(uint32_t));
+    *(buf + 19) = (uint8_t)(cf->victim_fp >> 8);
+    *(buf + 20) = (uint8_t)cf->victim_fp;
+
+    //the buckets are little endian bytes on any host, the padding dropped.
+    for (uint32_t i = 0; i < cf->buckets; i += BF_CUCKOO_LINE_BUCKETS) {
+        memcpy(buf + BF_CUCKOO_HEADER_LEN + (size_t)i * BF_CUCKOO_BUCKET_BYTES, bucketAt(cf, i),
+               lineBytes(cf->buckets, i));
+    }
+
+    return size;
+}
+
+CuckooFilter *LoadCF(const void *byte_array, size_t array_len)
+{
+    const uint8_t *buf  = (const uint8_t *)byte_array;
+    CuckooFilter *cf    = NULL;
+    uint32_t buckets    = 0;
+    uint64_t count      = 0;
+    uint32_t victim     = 0;
+    uint16_t victim_fp  = 0;
+
+    if (NULL == buf || array_len < BF_CUCKOO_HEADER_LEN || (int8_t)*buf != BF_MAGIC_CUCKOO
+        || *(buf + 1) != BF_CUCKOO_FP_BITS) {
+        return NULL;
+    }
+
+    memcpy(&buckets, buf + 2, sizeof(uint32_t));
+    memcpy(&count, buf + 6, sizeof(uint64_t));
+    memcpy(&victim, buf + 15, sizeof(uint32_t));
+    buckets = BF_NTOHL(buckets);
+    victim = BF_NTOHL(victim);
+    victim_fp = (uint16_t)(*(buf + 19) << 8 | *(buf + 20));
+
+    if (buckets == 0 || array_len != BF_CUCKOO_HEADER_LEN + (size_t)buckets * BF_CUCKOO_BUCKET_BYTES) {
+        return NULL;
+    }
+
+    if (*(buf + 14) > 1 || (*(buf + 14) && (victim >= buckets || victim_fp == 0 || victim_fp > BF_CUCKOO_FP_MASK))) {
+        return NULL;
+    }
+
+    cf = allocCF(buckets);
+    if (NULL == cf) {
+        return NULL;
+    }
+
+    for (uint32_t i = 0; i < buckets; i += BF_CUCKOO_LINE_BUCKETS) {
+        memcpy(bucketAt(cf, i), buf + BF_CUCKOO_HEADER_LEN + (size_t)i * BF_CUCKOO_BUCKET_BYTES,
+               lineBytes(buckets, i));
+    }
+    cf->count = BF_NTOHLL(count);
+    cf->victim_used = *(buf + 14);
+    cf->victim_bucket = victim;
+    cf->victim_fp = victim_fp;
+
+    return cf;
+}
+
+void DestroyCF(CuckooFilter *cf)
+{
+    if (NULL == cf) {
+        return;
+    }
+
+    free(cf->data);
+    free(cf);
+}
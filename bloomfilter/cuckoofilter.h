@@ -0,0 +1,216 @@
+/*
+BSD 3-Clause License
+
+Copyright (c) 2020, _Xiangqian
+        All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+        this list of conditions and the following disclaimer in the documentation
+and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+contributors may be used to endorse or promote products derived from
+        this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+        IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+        FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+        CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef BLOOMFILTER_CUCKOOFILTER_H
+#define BLOOMFILTER_CUCKOOFILTER_H
+
+#include "bloomfilter.h"
+
+//4 fingerprints of 12 bits to a bucket, a bucket is 6 little endian bytes.
+//0 marks an empty slot.
+#define BF_CUCKOO_FP_BITS       12
+#define BF_CUCKOO_SLOTS         4
+#define BF_CUCKOO_BUCKET_BYTES  (BF_CUCKOO_FP_BITS * BF_CUCKOO_SLOTS / 8)
+
+//in memory 10 buckets share a 64 byte line and the last 4 bytes pad it, so
+//a bucket never straddles two lines. Serialized without the padding.
+#define BF_CUCKOO_LINE_BYTES    64
+#define BF_CUCKOO_LINE_BUCKETS  (BF_CUCKOO_LINE_BYTES / BF_CUCKOO_BUCKET_BYTES)
+
+//sized for this share of the slots taken. 4 way buckets reach about 95%
+//before puts start to fail, 90% leaves room for keys past expect.
+#define BF_CUCKOO_LOAD          0.90
+
+//evictions before a put gives up and parks the key as the victim.
+#define BF_CUCKOO_MAX_KICKS     500
+
+//[int8 BF_MAGIC_CUCKOO][uint8 fp bits][uint32 BE buckets][uint64 BE count]
+//[uint8 victim used][uint32 BE victim bucket][uint16 BE victim fp]
+//then the buckets, BF_CUCKOO_BUCKET_BYTES each.
+#define BF_CUCKOO_HEADER_LEN    21
+
+typedef struct {
+    //seed
+    uint32_t seed;
+
+    //Number of buckets, any, not only powers of two. NewCF fills whole lines.
+    uint32_t buckets;
+
+    //keys in the filter.
+    uint64_t count;
+
+    //lines of BF_CUCKOO_LINE_BUCKETS buckets, 64 byte aligned.
+    uint8_t *data;
+
+    //xorshift state picking the slot to evict.
+    uint64_t rng;
+
+    //a key that found no slot: the filter is full while used.
+    uint8_t victim_used;
+    uint32_t victim_bucket;
+    uint16_t victim_fp;
+} CuckooFilter;
+
+/*
+ * @Description : New a cuckoo filter, 12 bit fingerprints in 4 way buckets.
+ *                Sized at 90% load, about 14.2 bits per key in memory
+ *                against 14.4 for a NewBF at fpp 0.001, keys can be
+ *                removed, and a lookup reads at most two cache lines. The
+ *                fpp is 8 * load / 4096, 0.18% at expect keys. Puts past
+ *                expect still fit until about 95% load, then fail. Not
+ *                thread safe.
+ * @Date        : 2026-10-17
+ * @Author      : Xiangqian5
+ * @Software    : Weibo Inc.
+ *
+ * @param:
+ *  expect      : The number of elements.
+ *
+ * @return:
+ *  cf          : The cuckoo filter. NULL->out of memory.
+ */
+
+CuckooFilter *NewCF(uint64_t expect);
+
+/*
+ * @Description : Put a number into the cuckoo filter. Putting a number
+ *                twice takes two slots, and needs two removes.
+ * @Date        : 2026-10-17
+ * @Author      : Xiangqian5
+ * @Software    : Weibo Inc.
+ *
+ * @param:
+ *  cf          : The cuckoo filter.
+ *  sn          : The number, hashed as PutUint64 does.
+ *
+ * @return:
+ *  is_put      : 1->put. 0->the filter is full.
+ */
+
+int PutUint64CF(CuckooFilter *cf, double sn);
+
+/*
+ * @Description : Remove a number put before. Removing a number never put
+ *                may remove another one sharing its fingerprint.
+ * @Date        : 2026-10-17
+ * @Author      : Xiangqian5
+ * @Software    : Weibo Inc.
+ *
+ * @param:
+ *  cf          : The cuckoo filter.
+ *  sn          : The number.
+ *
+ * @return:
+ *  removed     : 1->removed. 0->not in.
+ */
+
+int RemoveUint64CF(CuckooFilter *cf, double sn);
+
+/*
+ * @Description : Check a number is in the cuckoo filter or not.
+ * @Date        : 2026-10-17
+ * @Author      : Xiangqian5
+ * @Software    : Weibo Inc.
+ *
+ * @param:
+ *  cf          : The cuckoo filter.
+ *  sn          : The number.
+ *
+ * @return:
+ *  is_in       : 0->not in. 1->in.
+ */
+
+int MightContainNumberCF(CuckooFilter *cf, double sn);
+
+/*
+ * @Description : Bytes SerializeIntoCF writes, BF_CUCKOO_HEADER_LEN then
+ *                the buckets, BF_CUCKOO_BUCKET_BYTES each without the line
+ *                padding.
+ * @Date        : 2026-10-17
+ * @Author      : Xiangqian5
+ * @Software    : Weibo Inc.
+ *
+ * @param:
+ *  cf          : The cuckoo filter.
+ *
+ * @return:
+ *  size        : Bytes. 0->cf is NULL.
+ */
+
+size_t SerializedSizeCF(CuckooFilter *cf);
+
+/*
+ * @Description : Serialize a cuckoo filter into buf.
+ * @Date        : 2026-10-17
+ * @Author      : Xiangqian5
+ * @Software    : Weibo Inc.
+ *
+ * @param:
+ *  cf          : The cuckoo filter.
+ *  buf         : Output buffer.
+ *  buf_len     : Length of buf, at least SerializedSizeCF(cf).
+ *
+ * @return:
+ *  size        : Bytes written. 0->fail.
+ */
+
+size_t SerializeIntoCF(CuckooFilter *cf, uint8_t *buf, size_t buf_len);
+
+/*
+ * @Description : Load a cuckoo filter from SerializeIntoCF bytes.
+ * @Date        : 2026-10-17
+ * @Author      : Xiangqian5
+ * @Software    : Weibo Inc.
+ *
+ * @param:
+ *  byte_array  : byte array.
+ *  array_len   : length of byte array.
+ *
+ * @return:
+ *  cf          : The cuckoo filter. NULL->invalid byte array.
+ */
+
+CuckooFilter *LoadCF(const void *byte_array, size_t array_len);
+
+/*
+ * @Description : Free a cuckoo filter.
+ * @Date        : 2026-10-17
+ * @Author      : Xiangqian5
+ * @Software    : Weibo Inc.
+ *
+ * @param:
+ *  cf          : The cuckoo filter.
+ */
+
+void DestroyCF(CuckooFilter *cf);
+
+#endif //BLOOMFILTER_CUCKOOFILTER_H
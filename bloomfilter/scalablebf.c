@@ -0,0 +1,255 @@
+/*
+BSD 3-Clause License
+
+Copyright (c) 2020, _Xiangqian
+        All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+        this list of conditions and the following disclaimer in the documentation
+and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+contributors may be used to endorse or promote products derived from
+        this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+        IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+        FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+        CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define _DEFAULT_SOURCE
+
+#include "scalablebf.h"
+
+//fpp of stage i, the r^i terms sum to 1 / (1 - r).
+static double stageFpp(const ScalableBF *sbf, int stage)
+{
+    return sbf->fpp * (1 - BF_SCALABLE_TIGHTEN) * pow(BF_SCALABLE_TIGHTEN, stage);
+}
+
+//a key collides with (bits set / bit size)^hash_num, the stage is full once
+//that passes its fpp. Half full only at the unrounded optimal hash_num.
+static void newestFullBits(ScalableBF *sbf)
+{
+    BloomFilter *bf     = sbf->filters[sbf->stages - 1];
+    double fill         = pow(stageFpp(sbf, sbf->stages - 1), 1.0 / bf->bitset->hash_num);
+
+    sbf->full_bits = (uint64_t)(fill * bf->bitset->length * 64);
+}
+
+//0->out of memory, or BF_SCALABLE_MAX_STAGES.
+static int addStage(ScalableBF *sbf)
+{
+    int stage           = sbf->stages;
+    uint64_t expect     = sbf->expect;
+    BloomFilter *bf     = NULL;
+
+    if (stage >= BF_SCALABLE_MAX_STAGES) {
+        return 0;
+    }
+
+    for (int i = 0; i < stage && expect <= UINT64_MAX / BF_SCALABLE_GROWTH; i++) {
+        expect *= BF_SCALABLE_GROWTH;
+    }
+
+    bf = NewBF(expect, stageFpp(sbf, stage));
+    if (NULL == bf) {
+        return 0;
+    }
+
+    sbf->filters[stage] = bf;
+    sbf->stages++;
+    newestFullBits(sbf);
+
+    return 1;
+}
+
+ScalableBF *NewSBF(uint64_t expect, double fpp)
+{
+    ScalableBF *sbf = NULL;
+
+    if (!(fpp > 0)) {
+        return NULL;
+    }
+
+    sbf = (ScalableBF *)calloc(1, sizeof(ScalableBF));
+    if (NULL == sbf) {
+        return NULL;
+    }
+
+    sbf->expect = expect == 0 ? 1 : expect;
+    sbf->fpp = fpp;
+
+    if (!addStage(sbf)) {
+        free(sbf);
+        return NULL;
+    }
+
+    return sbf;
+}
+
+int PutUint64SBF(ScalableBF *sbf, double sn)
+{
+    BloomFilter *newest = NULL;
+
+    if (NULL == sbf || MightContainNumberSBF(sbf, sn)) {
+        return 0;
+    }
+
+    //no stage left or out of memory, the full newest stage still takes the
+    //key: its fpp rises past the target, but nothing put is ever missed.
+    if (BitCountBF(sbf->filters[sbf->stages - 1]) >= sbf->full_bits) {
+        addStage(sbf);
+    }
+    newest = sbf->filters[sbf->stages - 1];
+
+    return PutUint64(newest, sn);
+}
+
+int MightContainNumberSBF(ScalableBF *sbf, double sn)
+{
+    if (NULL == sbf) {
+        return 0;
+    }
+
+    for (int i = sbf->stages - 1; i >= 0; i--) {
+        if (MightContainNumber(sbf->filters[i], sn)) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+size_t SerializedSizeSBF(ScalableBF *sbf)
+{
+    size_t size = BF_SCALABLE_HEADER_LEN;
+
+    if (NULL == sbf) {
+        return 0;
+    }
+
+    for (int i = 0; i < sbf->stages; i++) {
+        size += SerializedSize(sbf->filters[i]);
+    }
+
+    return size;
+}
+
+size_t SerializeIntoSBF(ScalableBF *sbf, uint8_t *buf, size_t buf_len)
+{
+    size_t size         = SerializedSizeSBF(sbf);
+    size_t offset       = BF_SCALABLE_HEADER_LEN;
+    uint64_t expect     = 0;
+    uint64_t fpp        = 0;
+
+    if (size == 0 || NULL == buf || buf_len < size) {
+        return 0;
+    }
+
+    memcpy(&fpp, &sbf->fpp, sizeof(uint64_t));
+    expect = BF_HTONLL(sbf->expect);
+    fpp = BF_HTONLL(fpp);
+
+    *buf = BF_MAGIC_SCALABLE;
+    *(buf + 1) = sbf->stages;
+    memcpy(buf + 2, &expect, sizeof(uint64_t));
+    memcpy(buf + 10, &fpp, sizeof(uint64_t));
+
+    for (int i = 0; i < sbf->stages; i++) {
+        offset += SerializeInto(sbf->filters[i], buf + offset, size - offset);
+    }
+
+    return size;
+}
+
+ScalableBF *LoadSBF(const void *byte_array, size_t array_len)
+{
+    const uint8_t *buf  = (const uint8_t *)byte_array;
+    ScalableBF *sbf     = NULL;
+    size_t offset       = BF_SCALABLE_HEADER_LEN;
+    uint64_t expect     = 0;
+    uint64_t fpp        = 0;
+    int stages          = 0;
+
+    if (NULL == buf || array_len < BF_SCALABLE_HEADER_LEN || (int8_t)*buf != BF_MAGIC_SCALABLE) {
+        return NULL;
+    }
+
+    stages = *(buf + 1);
+    if (stages == 0 || stages > BF_SCALABLE_MAX_STAGES) {
+        return NULL;
+    }
+
+    sbf = (ScalableBF *)calloc(1, sizeof(ScalableBF));
+    if (NULL == sbf) {
+        return NULL;
+    }
+
+    memcpy(&expect, buf + 2, sizeof(uint64_t));
+    memcpy(&fpp, buf + 10, sizeof(uint64_t));
+    sbf->expect = BF_NTOHLL(expect);
+    fpp = BF_NTOHLL(fpp);
+    memcpy(&sbf->fpp, &fpp, sizeof(double));
+
+    for (int i = 0; i < stages; i++) {
+        uint32_t length = 0;
+        size_t size     = 0;
+
+        if (array_len - offset < HEADER_LEN || (int8_t)*(buf + offset) != BF_MAGIC_GUAVA) {
+            DestroySBF(sbf);
+            return NULL;
+        }
+
+        memcpy(&length, buf + offset + 2, sizeof(uint32_t));
+        size = HEADER_LEN + (size_t)BF_NTOHL(length) * sizeof(uint64_t);
+        if (array_len - offset < size) {
+            DestroySBF(sbf);
+            return NULL;
+        }
+
+        sbf->filters[i] = LoadBF((void *)(buf + offset), (double)size);
+        if (NULL == sbf->filters[i]) {
+            DestroySBF(sbf);
+            return NULL;
+        }
+
+        sbf->stages++;
+        offset += size;
+    }
+
+    if (offset != array_len) {
+        DestroySBF(sbf);
+        return NULL;
+    }
+
+    newestFullBits(sbf);
+
+    return sbf;
+}
+
+void DestroySBF(ScalableBF *sbf)
+{
+    if (NULL == sbf) {
+        return;
+    }
+
+    for (int i = 0; i < sbf->stages; i++) {
+        DestroyBF(sbf->filters[i]);
+    }
+
+    free(sbf);
+}
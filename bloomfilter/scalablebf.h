@@ -0,0 +1,184 @@
+/*
+BSD 3-Clause License
+
+Copyright (c) 2020, _Xiangqian
+        All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+        this list of conditions and the following disclaimer in the documentation
+and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+contributors may be used to endorse or promote products derived from
+        this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+        IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+        FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+        CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef BLOOMFILTER_SCALABLEBF_H
+#define BLOOMFILTER_SCALABLEBF_H
+
+#include "bloomfilter.h"
+
+//Almeida et al. scalable bloom filter: stage i expects expect * 2^i keys at
+//fpp * (1 - r) * r^i, so the fpps of all stages sum below fpp.
+#define BF_SCALABLE_GROWTH      2
+#define BF_SCALABLE_TIGHTEN     0.8
+#define BF_SCALABLE_MAX_STAGES  32
+
+//[int8 BF_MAGIC_SCALABLE][uint8 stages][uint64 BE expect][uint64 BE fpp bits]
+//then each stage in the Serialized layout.
+#define BF_SCALABLE_HEADER_LEN  18
+
+typedef struct {
+    //keys expected by the first stage.
+    uint64_t expect;
+
+    //bound on the fpp of the whole chain.
+    double fpp;
+
+    //stages in use, the newest takes the puts.
+    uint8_t stages;
+
+    //set bits at which the newest stage reaches its fpp.
+    uint64_t full_bits;
+
+    //guava filters, oldest first.
+    BloomFilter *filters[BF_SCALABLE_MAX_STAGES];
+} ScalableBF;
+
+/*
+ * @Description : New a scalable bloom filter. It starts as one NewBF of
+ *                expect, and chains a new stage twice the size at a
+ *                tighter fpp each time the newest one reaches its own, so the
+ *                fpp stays below fpp however many keys come. Not thread
+ *                safe, one writer at a time.
+ * @Date        : 2026-10-17
+ * @Author      : Xiangqian5
+ * @Software    : Weibo Inc.
+ *
+ * @param:
+ *  expect      : The number of elements of the first stage.
+ *  fpp         : The rate of false positive of the whole chain.
+ *
+ * @return:
+ *  sbf         : The scalable bloom filter. NULL->out of memory, or fpp
+ *                not above 0.
+ */
+
+ScalableBF *NewSBF(uint64_t expect, double fpp);
+
+/*
+ * @Description : Put a number into the newest stage, unless a stage already
+ *                holds it: a duplicate would fill stages for nothing. Past
+ *                BF_SCALABLE_MAX_STAGES, or out of memory for a new stage,
+ *                the full newest stage takes it and the fpp drifts up.
+ * @Date        : 2026-10-17
+ * @Author      : Xiangqian5
+ * @Software    : Weibo Inc.
+ *
+ * @param:
+ *  sbf         : The scalable bloom filter.
+ *  sn          : The number.
+ *
+ * @return:
+ *  changed     : 1->put. 0->might have been in.
+ */
+
+int PutUint64SBF(ScalableBF *sbf, double sn);
+
+/*
+ * @Description : Check a number is in the scalable bloom filter or not, the
+ *                newest stage, holding most keys, first.
+ * @Date        : 2026-10-17
+ * @Author      : Xiangqian5
+ * @Software    : Weibo Inc.
+ *
+ * @param:
+ *  sbf         : The scalable bloom filter.
+ *  sn          : The number.
+ *
+ * @return:
+ *  is_in       : 0->not in. 1->in.
+ */
+
+int MightContainNumberSBF(ScalableBF *sbf, double sn);
+
+/*
+ * @Description : Bytes SerializeIntoSBF writes, BF_SCALABLE_HEADER_LEN
+ *                then every stage as Serialized writes it.
+ * @Date        : 2026-10-17
+ * @Author      : Xiangqian5
+ * @Software    : Weibo Inc.
+ *
+ * @param:
+ *  sbf         : The scalable bloom filter.
+ *
+ * @return:
+ *  size        : Bytes. 0->sbf is NULL.
+ */
+
+size_t SerializedSizeSBF(ScalableBF *sbf);
+
+/*
+ * @Description : Serialize the whole chain into buf.
+ * @Date        : 2026-10-17
+ * @Author      : Xiangqian5
+ * @Software    : Weibo Inc.
+ *
+ * @param:
+ *  sbf         : The scalable bloom filter.
+ *  buf         : Output buffer.
+ *  buf_len     : Length of buf, at least SerializedSizeSBF(sbf).
+ *
+ * @return:
+ *  size        : Bytes written. 0->fail.
+ */
+
+size_t SerializeIntoSBF(ScalableBF *sbf, uint8_t *buf, size_t buf_len);
+
+/*
+ * @Description : Load a scalable bloom filter from SerializeIntoSBF bytes,
+ *                it keeps growing from where it was.
+ * @Date        : 2026-10-17
+ * @Author      : Xiangqian5
+ * @Software    : Weibo Inc.
+ *
+ * @param:
+ *  byte_array  : byte array.
+ *  array_len   : length of byte array.
+ *
+ * @return:
+ *  sbf         : The scalable bloom filter. NULL->invalid byte array.
+ */
+
+ScalableBF *LoadSBF(const void *byte_array, size_t array_len);
+
+/*
+ * @Description : Free a scalable bloom filter and all its stages.
+ * @Date        : 2026-10-17
+ * @Author      : Xiangqian5
+ * @Software    : Weibo Inc.
+ *
+ * @param:
+ *  sbf         : The scalable bloom filter.
+ */
+
+void DestroySBF(ScalableBF *sbf);
+
+#endif //BLOOMFILTER_SCALABLEBF_H
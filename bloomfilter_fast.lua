@@ -0,0 +1,129 @@
+--Fast path of bloomfilter: no pcall, no error strings, no cdata per call.
+--A filter is checked once by bind(), the returned functions then go
+--straight to the C api and return booleans. Lua strings are passed as
+--const char * + length, not copied. Errors are raised, not returned.
+
+local ffi = require("ffi")
+local bloomfilter = require("bloomfilter")
+
+local ffi_new = ffi.new
+local ffi_typeof = ffi.typeof
+local ffi_istype = ffi.istype
+local tonumber = tonumber
+
+local _M = {}
+
+local bf_ptr = ffi_typeof('BloomFilter *')
+local uint64_arr = ffi_typeof('uint64_t[?]')
+local uint8_arr = ffi_typeof('uint8_t[?]')
+local handler
+
+--reused by every bound filter, keys are copied in per call.
+local batch_cap = 0
+local batch_keys
+local batch_out
+
+local function batch_reserve(n)
+    if n > batch_cap then
+        batch_cap = n
+        batch_keys = ffi_new(uint64_arr, n)
+        batch_out = ffi_new(uint8_arr, n)
+    end
+end
+
+function _M.init()
+    if not bloomfilter.initted() then
+        local initted, err = bloomfilter.init()
+        if initted == nil then
+            return nil, err
+        end
+    end
+
+    handler = bloomfilter.handler()
+
+    return true, nil
+end
+
+--bf from bloomfilter.new_bf, load_bf, view_bf ... The returned functions
+--hold bf, it lives as long as they do.
+function _M.bind(bf)
+    if handler == nil then
+        return nil, "aborted bind error. call init first."
+    end
+
+    if not ffi_istype(bf_ptr, bf) or bf == nil or bf.bitset == nil then
+        return nil, "aborted bind error. not a bloomfilter."
+    end
+
+    local MightContainNumber = handler.MightContainNumber
+    local MightContainBytes = handler.MightContainBytes
+    local MightContainInt32 = handler.MightContainInt32
+    local MightContainStrNumberLen = handler.MightContainStrNumberLen
+    local MightContainNumberBatch = handler.MightContainNumberBatch
+    local PutUint64 = handler.PutUint64
+    local PutBytes = handler.PutBytes
+    local PutInt32 = handler.PutInt32
+    local PutUint64Batch = handler.PutUint64Batch
+
+    local fast = {}
+
+    function fast.might_contain_number(element)
+        return MightContainNumber(bf, element) == 1
+    end
+
+    function fast.might_contain_bytes(element)
+        return MightContainBytes(bf, element, #element) == 1
+    end
+
+    function fast.might_contain_int32(element)
+        return MightContainInt32(bf, element) == 1
+    end
+
+    --same answer as bloomfilter.might_contain_str_number, element is
+    --parsed in place, no StrNumber copy.
+    function fast.might_contain_str_number(element)
+        return MightContainStrNumberLen(bf, element, #element) == 1
+    end
+
+    function fast.put_uint64(element)
+        return PutUint64(bf, element) == 1
+    end
+
+    function fast.put_bytes(element)
+        return PutBytes(bf, element, #element) == 1
+    end
+
+    function fast.put_int32(element)
+        return PutInt32(bf, element) == 1
+    end
+
+    --fills out[1..n] with booleans, returns the number of hits.
+    function fast.might_contain_number_batch(elements, out)
+        local n = #elements
+        batch_reserve(n)
+        for i = 1, n do
+            batch_keys[i - 1] = elements[i]
+        end
+
+        local hits = MightContainNumberBatch(bf, batch_keys, n, batch_out)
+        for i = 1, n do
+            out[i] = batch_out[i - 1] == 1
+        end
+
+        return tonumber(hits)
+    end
+
+    function fast.put_uint64_batch(elements)
+        local n = #elements
+        batch_reserve(n)
+        for i = 1, n do
+            batch_keys[i - 1] = elements[i]
+        end
+
+        return tonumber(PutUint64Batch(bf, batch_keys, n))
+    end
+
+    return fast, nil
+end
+
+return _M
@@ -17,4 +17,45 @@ uint32_t MurmurHash3_x86_32  ( const void * key, int len, uint32_t seed);
 void MurmurHash3_x86_128 ( const void * key, int len, uint32_t seed, void * out );
 void MurmurHash3_x64_128 ( const void * key, int len, uint32_t seed, void * out );
 
+//-----------------------------------------------------------------------------
+// MurmurHash3_x64_128 of the 8 little endian bytes of key, bit exact with
+// the generic function. No block loop and no tail switch, so it inlines.
+
+static inline uint64_t MurmurHash3_fmix64_inline ( uint64_t k )
+{
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdLLU;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53LLU;
+    k ^= k >> 33;
+
+    return k;
+}
+
+static inline void MurmurHash3_x64_128_u64 ( uint64_t key, uint32_t seed, void * out )
+{
+    uint64_t h1 = seed;
+    uint64_t h2 = seed;
+    uint64_t k1 = key;
+
+    k1 *= 0x87c37b91114253d5LLU;
+    k1 = (k1 << 31) | (k1 >> 33);
+    k1 *= 0x4cf5ad432745937fLLU;
+    h1 ^= k1;
+
+    h1 ^= 8; h2 ^= 8;
+
+    h1 += h2;
+    h2 += h1;
+
+    h1 = MurmurHash3_fmix64_inline(h1);
+    h2 = MurmurHash3_fmix64_inline(h2);
+
+    h1 += h2;
+    h2 += h1;
+
+    ((uint64_t*)out)[0] = h1;
+    ((uint64_t*)out)[1] = h2;
+}
+
 #endif //LUA_RESTY_BLOOMFILTER_MURMURHASH3_H
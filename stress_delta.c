@@ -0,0 +1,150 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "bloomfilter/bloomfilter.h"
+
+//puts between two deltas, and a ReplaceBitsetBF, an IntersectBF or a
+//UnionBF with another filter every DELTA_MERGE_EVERY rounds, in turn.
+#define DELTA_KEYS      100000
+#define DELTA_FPP       0.01
+#define DELTA_ROUNDS    60
+#define DELTA_PUTS      5000
+#define DELTA_MERGE_EVERY 4
+
+static uint64_t rng = 0x9e3779b97f4a7c15ULL;
+
+static uint64_t nextKey(void)
+{
+    rng = rng * 6364136223846793005ULL + 1442695040888963407ULL;
+
+    return rng >> 20;
+}
+
+//SerializeDelta until nothing is left, in small buffers every other round
+//so ranges left dirty ride the next one. 0->a delta was refused.
+static int shipDelta(BloomFilter *src, BloomFilter **replicas, int n, int round, uint64_t *bytes)
+{
+    size_t size = DeltaSizeBF(src);
+    uint8_t *buf = (uint8_t *)malloc(size);
+    size_t buf_len = round & 1 ? size / 3 + BF_DELTA_HEADER_LEN + BF_DELTA_RANGE_LEN + BF_DIRTY_WORDS * 8 : size;
+    size_t len = 0;
+    int ok = 1;
+
+    do {
+        len = SerializeDelta(src, buf, buf_len);
+        *bytes += len;
+        for (int i = 0; i < n; i++) {
+            ok &= ApplyDelta(*(replicas + i), buf, len);
+        }
+    } while (ok && len > BF_DELTA_HEADER_LEN);
+
+    free(buf);
+
+    return ok;
+}
+
+//the replica holds exactly the bits and the bit count of bf.
+static int sameBF(BloomFilter *bf, BloomFilter *replica, uint8_t *a, uint8_t *b, size_t len)
+{
+    SerializeInto(bf, a, len);
+    SerializeInto(replica, b, len);
+
+    return memcmp(a, b, len) == 0 && BitCountBF(bf) == BitCountBF(replica);
+}
+
+static int run(int8_t magic, const char *name)
+{
+    BloomFilter *bf = NewBFStrategy(DELTA_KEYS, DELTA_FPP, magic);
+    BloomFilter *replicas[2];
+    uint64_t first_keys[1000];
+    uint64_t bytes = 0;
+    size_t len = 0;
+    uint8_t *a = NULL;
+    uint8_t *b = NULL;
+    int mismatches = 0;
+    int merges[3] = {0};
+    int stale = 0;
+
+    //a plain replica and a concurrent one, both start empty.
+    replicas[0] = NewBFStrategy(DELTA_KEYS, DELTA_FPP, magic);
+    replicas[1] = NewBFStrategy(DELTA_KEYS, DELTA_FPP, magic);
+    if (NULL == bf || NULL == replicas[0] || NULL == replicas[1] || !EnableDirtyBF(bf)
+            || !SetConcurrentBF(replicas[1], 1)) {
+        printf("%-12s setup FAIL\n", name);
+        return 0;
+    }
+
+    len = SerializedSize(bf);
+    a = (uint8_t *)malloc(len);
+    b = (uint8_t *)malloc(len);
+
+    for (int i = 0; i < 1000; i++) {
+        first_keys[i] = nextKey();
+        PutUint64(bf, (double)first_keys[i]);
+    }
+
+    for (int round = 0; round < DELTA_ROUNDS; round++) {
+        if (round % DELTA_MERGE_EVERY == DELTA_MERGE_EVERY - 1) {
+            BloomFilter *src = NewBFStrategy(DELTA_KEYS, DELTA_FPP, magic);
+            int merge = round / DELTA_MERGE_EVERY % 3;
+            int ok = 0;
+
+            for (int i = 0; i < DELTA_PUTS * 4; i++) {
+                PutUint64(src, (double)nextKey());
+            }
+            if (merge == 0) {
+                ok = ReplaceBitsetBF(bf, src);
+            } else {
+                ok = merge == 1 ? IntersectBF(bf, src) : UnionBF(bf, src);
+                DestroyBF(src);
+            }
+            if (!ok) {
+                printf("%-12s merge %d FAIL\n", name, merge);
+                return 0;
+            }
+            merges[merge]++;
+        } else {
+            for (int i = 0; i < DELTA_PUTS; i++) {
+                PutUint64(bf, (double)nextKey());
+            }
+        }
+
+        if (!shipDelta(bf, replicas, 2, round, &bytes)) {
+            printf("%-12s apply delta FAIL\n", name);
+            return 0;
+        }
+
+        for (int i = 0; i < 2; i++) {
+            mismatches += !sameBF(bf, replicas[i], a, b, len);
+        }
+    }
+
+    //the keys put before the first replace went with it, on both sides.
+    for (int i = 0; i < 1000; i++) {
+        stale += MightContainNumber(replicas[0], (double)first_keys[i])
+                 != MightContainNumber(bf, (double)first_keys[i]);
+    }
+
+    printf("%-12s rounds:%d replaces:%d intersects:%d unions:%d delta bytes:%llu mismatches:%d stale keys:%d %s\n",
+           name, DELTA_ROUNDS, merges[0], merges[1], merges[2], (unsigned long long)bytes, mismatches, stale,
+           mismatches == 0 && stale == 0 ? "ok" : "FAIL");
+
+    free(a);
+    free(b);
+    DestroyBF(bf);
+    DestroyBF(replicas[0]);
+    DestroyBF(replicas[1]);
+
+    return mismatches == 0 && stale == 0;
+}
+
+int main() {
+    int ok = 1;
+
+    ok &= run(BF_MAGIC_GUAVA, "guava");
+    ok &= run(BF_MAGIC_BLOCKED, "blocked");
+    ok &= run(BF_MAGIC_SPLIT_BLOCK, "split_block");
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,201 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include "bloomfilter/bloomfilter.h"
+
+//keys in every reloaded bitset, a check of one must never miss.
+#define RELOAD_KEYS     1000000
+#define RELOAD_FPP      0.01
+#define RELOAD_MAX_THREADS 64
+//one latency kept per RELOAD_SAMPLE_EVERY checks, at most RELOAD_SAMPLES.
+#define RELOAD_SAMPLE_EVERY 16
+#define RELOAD_SAMPLES  (1 << 20)
+
+typedef struct {
+    uint64_t seed;
+    uint64_t checks;
+    uint64_t misses;
+    size_t samples;
+    uint32_t *latency;
+} ReloadReader;
+
+static BloomFilter *bf = NULL;
+static volatile int stop = 0;
+static uint8_t *blobs[2] = {NULL, NULL};
+static size_t blob_len = 0;
+
+static uint64_t nowNs(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void *checkKeys(void *p)
+{
+    ReloadReader *reader = (ReloadReader *)p;
+    uint64_t x = reader->seed;
+
+    while (!stop) {
+        uint64_t key = 0;
+        uint64_t begin = 0;
+        uint64_t cost = 0;
+
+        x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+        key = (x >> 33) % RELOAD_KEYS;
+
+        begin = nowNs();
+        if (!MightContainNumber(bf, (double)key)) {
+            reader->misses++;
+        }
+        cost = nowNs() - begin;
+
+        if (reader->checks++ % RELOAD_SAMPLE_EVERY == 0 && reader->samples < RELOAD_SAMPLES) {
+            *(reader->latency + reader->samples++) = cost > UINT32_MAX ? UINT32_MAX : (uint32_t)cost;
+        }
+    }
+
+    return NULL;
+}
+
+//new keys racing the reloads, above the ones every bitset holds.
+static void *putKeys(void *p)
+{
+    uint64_t key = RELOAD_KEYS;
+
+    while (!stop) {
+        PutUint64(bf, (double)key++);
+    }
+
+    return NULL;
+}
+
+static int compareLatency(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+int main(int argc, char **argv) {
+    pthread_t tids[RELOAD_MAX_THREADS];
+    pthread_t writer;
+    ReloadReader readers[RELOAD_MAX_THREADS];
+    int seconds = argc > 1 ? atoi(argv[1]) : 10;
+    int threads = argc > 2 ? atoi(argv[2]) : 4;
+    uint64_t replace_max = 0;
+    uint64_t replace_sum = 0;
+    uint64_t checks = 0;
+    uint64_t misses = 0;
+    uint32_t *latency = NULL;
+    size_t samples = 0;
+    uint8_t *blob = NULL;
+    uint64_t popcount = 0;
+    int reloads = 0;
+
+    if (seconds <= 0 || threads <= 0 || threads > RELOAD_MAX_THREADS) {
+        printf("usage: stress_reload [seconds] [threads 1..%d]\n", RELOAD_MAX_THREADS);
+        return 1;
+    }
+
+    //two versions, the base keys and a different half of extra keys each.
+    for (int v = 0; v < 2; v++) {
+        BloomFilter *src = NewBF(RELOAD_KEYS * 2, RELOAD_FPP);
+
+        for (uint64_t key = 0; key < RELOAD_KEYS; key++) {
+            PutUint64(src, (double)key);
+        }
+        for (uint64_t key = 0; key < RELOAD_KEYS / 2; key++) {
+            PutUint64(src, (double)(RELOAD_KEYS * (3 + v) + key));
+        }
+        blob_len = SerializedSize(src);
+        blobs[v] = (uint8_t *)malloc(blob_len);
+        SerializeInto(src, blobs[v], blob_len);
+        DestroyBF(src);
+    }
+
+    bf = LoadBF(blobs[0], (double)blob_len);
+    if (NULL == bf || !SetConcurrentBF(bf, 1)) {
+        printf("load FAIL\n");
+        return 1;
+    }
+
+    for (int i = 0; i < threads; i++) {
+        memset(&readers[i], 0, sizeof(ReloadReader));
+        readers[i].seed = (uint64_t)i + 1;
+        readers[i].latency = (uint32_t *)malloc(sizeof(uint32_t) * RELOAD_SAMPLES);
+        pthread_create(&tids[i], NULL, checkKeys, &readers[i]);
+    }
+    pthread_create(&writer, NULL, putKeys, NULL);
+
+    //1 Hz, as a worker reloading from redis would.
+    for (int s = 0; s < seconds; s++) {
+        BloomFilter *src = NULL;
+        uint64_t begin = 0;
+        uint64_t cost = 0;
+
+        sleep(1);
+        src = LoadBF(blobs[(s + 1) & 1], (double)blob_len);
+        begin = nowNs();
+        if (NULL == src || !ReplaceBitsetBF(bf, src)) {
+            printf("replace FAIL\n");
+            return 1;
+        }
+        cost = nowNs() - begin;
+        replace_sum += cost;
+        replace_max = cost > replace_max ? cost : replace_max;
+        reloads++;
+    }
+
+    stop = 1;
+    for (int i = 0; i < threads; i++) {
+        pthread_join(tids[i], NULL);
+    }
+    pthread_join(writer, NULL);
+
+    latency = (uint32_t *)malloc(sizeof(uint32_t) * RELOAD_SAMPLES * threads);
+    for (int i = 0; i < threads; i++) {
+        checks += readers[i].checks;
+        misses += readers[i].misses;
+        memcpy(latency + samples, readers[i].latency, sizeof(uint32_t) * readers[i].samples);
+        samples += readers[i].samples;
+        free(readers[i].latency);
+    }
+    qsort(latency, samples, sizeof(uint32_t), compareLatency);
+
+    printf("threads:%d reloads:%d replace avg:%.2fms max:%.2fms\n", threads, reloads,
+           replace_sum / 1e6 / reloads, replace_max / 1e6);
+    printf("checks:%llu false negatives:%llu %s\n", (unsigned long long)checks, (unsigned long long)misses,
+           misses == 0 ? "ok" : "FAIL");
+    if (samples > 0) {
+        printf("check latency p50:%uns p99:%uns p99.9:%uns p99.99:%uns max:%uns\n",
+               latency[samples / 2], latency[samples * 99 / 100], latency[samples * 999 / 1000],
+               latency[samples * 9999 / 10000], latency[samples - 1]);
+    }
+
+    //puts in flight on the old longs during a drain may be off by a few.
+    blob = (uint8_t *)malloc(blob_len);
+    SerializeInto(bf, blob, blob_len);
+    for (size_t i = HEADER_LEN; i + sizeof(uint64_t) <= blob_len; i += sizeof(uint64_t)) {
+        uint64_t word = 0;
+
+        memcpy(&word, blob + i, sizeof(uint64_t));
+        popcount += __builtin_popcountll(word);
+    }
+    printf("bit_count:%llu popcount:%llu\n", (unsigned long long)BitCountBF(bf), (unsigned long long)popcount);
+
+    free(blob);
+    free(latency);
+    DestroyBF(bf);
+    free(blobs[0]);
+    free(blobs[1]);
+
+    return misses == 0 ? 0 : 1;
+}
@@ -0,0 +1,99 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include "bloomfilter/bloomfilter.h"
+
+//forked writers, each putting its own range of keys.
+#define FORK_CHILDREN   16
+#define FORK_KEYS       50000
+#define FORK_EXPECT     (FORK_CHILDREN * FORK_KEYS)
+#define FORK_FPP        0.001
+
+//every child's keys visible in bf after waitpid. 0->fail.
+static int forkPut(BloomFilter *bf, int memfd, const char *name)
+{
+    pid_t pids[FORK_CHILDREN];
+    int status = 0;
+    int missing = 0;
+    int ok = 1;
+
+    for (int i = 0; i < FORK_CHILDREN; i++) {
+        pids[i] = fork();
+        if (pids[i] < 0) {
+            perror("fork");
+            return 0;
+        }
+
+        if (pids[i] == 0) {
+            //a memfd is attached anew, as an unrelated process would.
+            BloomFilter *child = memfd < 0 ? bf : AttachSharedBF(memfd);
+
+            if (NULL == child) {
+                _exit(2);
+            }
+            for (uint64_t key = (uint64_t)i * FORK_KEYS; key < (uint64_t)(i + 1) * FORK_KEYS; key++) {
+                PutUint64(child, (double)key);
+            }
+            _exit(0);
+        }
+    }
+
+    for (int i = 0; i < FORK_CHILDREN; i++) {
+        if (waitpid(pids[i], &status, 0) != pids[i] || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            ok = 0;
+        }
+    }
+
+    for (uint64_t key = 0; key < FORK_EXPECT; key++) {
+        if (!MightContainNumber(bf, (double)key)) {
+            missing++;
+        }
+    }
+
+    printf("%-9s children:%d keys:%d missing:%d bit_count:%llu %s\n", name, FORK_CHILDREN, FORK_EXPECT,
+           missing, (unsigned long long)BitCountBF(bf), ok && missing == 0 ? "ok" : "FAIL");
+
+    return ok && missing == 0;
+}
+
+int main() {
+    BloomFilter *bf = NULL;
+    int memfd = -1;
+    int ok = 1;
+
+    bf = NewSharedBF(FORK_EXPECT, FORK_FPP, BF_MAGIC_GUAVA, -1);
+    if (NULL == bf) {
+        printf("anonymous NewSharedBF FAIL\n");
+        return 1;
+    }
+    ok &= forkPut(bf, -1, "anonymous");
+    DestroyBF(bf);
+
+    memfd = memfd_create("bloomfilter", 0);
+    if (memfd < 0) {
+        perror("memfd_create");
+        return 1;
+    }
+    bf = NewSharedBF(FORK_EXPECT, FORK_FPP, BF_MAGIC_BLOCKED, memfd);
+    if (NULL == bf) {
+        printf("memfd NewSharedBF FAIL\n");
+        return 1;
+    }
+    ok &= forkPut(bf, memfd, "memfd");
+    DestroyBF(bf);
+
+    //the memfd holds a filter now, a second NewSharedBF must refuse it.
+    bf = NewSharedBF(FORK_EXPECT, FORK_FPP, BF_MAGIC_BLOCKED, memfd);
+    printf("reuse     non empty fd %s\n", NULL == bf ? "refused ok" : "accepted FAIL");
+    if (NULL != bf) {
+        DestroyBF(bf);
+        ok = 0;
+    }
+    close(memfd);
+
+    return ok ? 0 : 1;
+}